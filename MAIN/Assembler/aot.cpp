@@ -0,0 +1,106 @@
+#include <iostream>
+#include <string>
+#include "assembler.h"
+#include "output_writer.h"
+#include "c_backend.h"
+
+using namespace std;
+
+// Usage: aot [--optimize] [--thread-jumps] [--remove-dead] [--shared] [--cc COMPILER]
+//            [--emit-c FILE] [-o OUTPUT] file
+// Assembles a source (or takes an object file written with --object as it
+// is) and translates it to C (see c_backend.h), then builds it with the
+// system C compiler: a native executable by default, which runs the program
+// and prints what the simulator prints, or with --shared a shared object that
+// exports aot_run(). --emit-c keeps the C file (only writing it when there is
+// no -o), --cc picks the compiler. The optimizer options are those of
+// assignment1 and only apply to a source.
+int main(int argc, char *argv[])
+{
+    string filename;
+    string output;
+    string c_file;
+    string compiler = "cc";
+    AssemblerOptions options;
+    bool shared = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--optimize")
+        {
+            options.optimize = true;
+        }
+        else if (arg == "--thread-jumps")
+        {
+            options.thread_jumps = true;
+        }
+        else if (arg == "--remove-dead")
+        {
+            options.remove_dead = true;
+        }
+        else if (arg == "--shared")
+        {
+            shared = true;
+        }
+        else if (arg == "--cc" && i + 1 < argc)
+        {
+            compiler = argv[++i];
+        }
+        else if (arg == "--emit-c" && i + 1 < argc)
+        {
+            c_file = argv[++i];
+        }
+        else if (arg == "-o" && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else
+        {
+            filename = arg;
+        }
+    }
+
+    if (filename.empty() || (output.empty() && c_file.empty()))
+    {
+        cerr << "Usage: aot [--optimize] [--thread-jumps] [--remove-dead] [--shared] [--cc COMPILER]" << endl
+             << "           [--emit-c FILE] [-o OUTPUT] file" << endl;
+        return 1;
+    }
+
+    LoadedProgram program;
+    if (!loadProgram(filename, options, program))
+    {
+        return 1;
+    }
+
+    bool keep_c = !c_file.empty();
+    if (!keep_c)
+    {
+        c_file = output + ".c";
+    }
+    {
+        OutputWriter out(c_file);
+        out.write(translateToC(program.image, program.symbols, filename));
+        if (!out.flush())
+        {
+            cerr << "Error: Could not write " << c_file << "!" << endl;
+            return 1;
+        }
+    }
+
+    if (!output.empty())
+    {
+        bool built = compileC(c_file, output, shared, compiler);
+        if (!keep_c)
+        {
+            remove(c_file.c_str());
+        }
+        if (!built)
+        {
+            cerr << "Error: " << compiler << " could not build " << output << "!" << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <dlfcn.h>
+#include "assembler.h"
+#include "source_reader.h"
+#include "output_writer.h"
+#include "program_generator.h"
+#include "simulator.h"
+#include "c_backend.h"
+
+using namespace std;
+
+// Differential test of the C backend against the simulator. Every program
+// (the files given, or generated ones alternating between
+// ProgramGenerator::generate() and generateLoops()) is translated, built as a
+// shared object and loaded with dlopen(). Both then run it from a range of
+// start addresses (the entry, instructions across the program, before and
+// after the image, EXTERN) with step limits up to a million, as generated
+// code can loop forever, and with registers and condition set from a fixed
+// seed. Status, steps, pc, registers and condition have to be the same. Link
+// with -ldl on glibc older than 2.34.
+//
+// Usage: aot_diff [--programs N] [--lines N] [--seed N] [--cc COMPILER] [file]...
+
+struct RunResult
+{
+    int status = 0;
+    uint64_t steps = 0;
+    MachineState state;
+};
+
+int main(int argc, char *argv[])
+{
+    size_t programs = 20;
+    size_t lines = 300;
+    uint64_t seed = 1;
+    string compiler = "cc";
+    vector<string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--programs" && i + 1 < argc)
+        {
+            programs = stoull(argv[++i]);
+        }
+        else if (arg == "--lines" && i + 1 < argc)
+        {
+            lines = stoull(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            seed = stoull(argv[++i]);
+        }
+        else if (arg == "--cc" && i + 1 < argc)
+        {
+            compiler = argv[++i];
+        }
+        else
+        {
+            files.push_back(arg);
+        }
+    }
+
+    vector<pair<string, string>> sources; // name, text
+    for (const string &file : files)
+    {
+        SourceReader reader;
+        if (!reader.open(file))
+        {
+            cerr << "Error: Could not open " << file << "!" << endl;
+            return 1;
+        }
+        sources.push_back({file, string(reader.text())});
+    }
+    for (size_t i = 0; files.empty() && i < programs; i++)
+    {
+        ProgramGenerator generator(seed + i);
+        bool loops = i % 2 == 1;
+        string name = (loops ? "loops seed " : "generated seed ") + to_string(seed + i);
+        sources.push_back({name, loops ? generator.generateLoops(1 + i % 4, 40) : generator.generate(lines)});
+    }
+
+    const uint64_t step_limits[] = {0, 1, 2, 3, 5, 8, 13, 100, 10000, 1000000};
+    uint64_t random = seed * 0x9E3779B97F4A7C15ull + 1;
+    auto next = [&random]()
+    {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        return random;
+    };
+
+    size_t failures = 0, runs = 0;
+    for (size_t program = 0; program < sources.size(); program++)
+    {
+        const string &name = sources[program].first;
+        ObjectModule module = assemble(sources[program].second);
+        Simulator simulator(loadImage(module));
+        const ProgramImage &image = simulator.programImage();
+
+        string c_file = "aot_diff.tmp.c";
+        string library = "./aot_diff_" + to_string(program) + ".tmp.so";
+        {
+            OutputWriter out(c_file);
+            out.write(translateToC(module, name));
+            if (!out.flush())
+            {
+                cerr << "Error: Could not write " << c_file << "!" << endl;
+                return 1;
+            }
+        }
+        bool built = compileC(c_file, library, true, compiler);
+        remove(c_file.c_str());
+        void *handle = built ? dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL) : nullptr;
+        remove(library.c_str());
+        AotRun aot_run = handle != nullptr ? (AotRun)dlsym(handle, "aot_run") : nullptr;
+        if (aot_run == nullptr)
+        {
+            cerr << "Error: Could not build and load the translation of " << name << "!" << endl;
+            return 1;
+        }
+
+        // Where runs start: the entry, up to 16 instructions spread over the
+        // program, and the addresses around it
+        vector<int> starts = {image.entry, image.base - 3, image.base + (int)image.size(), -1};
+        size_t count = simulator.instructionCount();
+        for (size_t i = 0; i < count; i += max<size_t>(count / 16, 1))
+        {
+            starts.push_back(simulator.instruction(i).lc);
+        }
+
+        size_t program_failures = 0;
+        for (int start : starts)
+        {
+            for (uint64_t limit : step_limits)
+            {
+                MachineState initial = simulator.initialState();
+                initial.pc = start;
+                for (int r = 1; r <= 4; r++)
+                {
+                    initial.registers[r] = (int64_t)(next() % 21) - 10;
+                }
+                initial.zero = next() % 2 == 0;
+
+                RunResult expected, actual;
+                expected.state = initial;
+                SimResult result = simulator.run(expected.state, limit);
+                expected.status = (int)result.status;
+                expected.steps = result.steps;
+
+                actual.state = initial;
+                AotState state = {{}, initial.zero, initial.pc, actual.state.memory.data()};
+                for (int r = 0; r < 5; r++)
+                {
+                    state.registers[r] = initial.registers[r];
+                }
+                actual.status = aot_run(&state, limit, &actual.steps);
+                for (int r = 0; r < 5; r++)
+                {
+                    actual.state.registers[r] = state.registers[r];
+                }
+                actual.state.zero = state.zero != 0;
+                actual.state.pc = state.pc;
+
+                bool same = expected.status == actual.status && expected.steps == actual.steps &&
+                            expected.state.pc == actual.state.pc && expected.state.zero == actual.state.zero;
+                for (int r = 0; r < 5; r++)
+                {
+                    same = same && expected.state.registers[r] == actual.state.registers[r];
+                }
+                runs++;
+                if (!same && program_failures++ < 3)
+                {
+                    cout << name << ": start " << start << ", limit " << limit << ": simulator "
+                         << simStatusName((SimStatus)expected.status) << " at " << expected.state.pc << " after "
+                         << expected.steps << ", native " << simStatusName((SimStatus)actual.status) << " at "
+                         << actual.state.pc << " after " << actual.steps << endl;
+                }
+            }
+        }
+        dlclose(handle);
+        failures += program_failures;
+        cout << name << ": " << (program_failures == 0 ? "match" : "MISMATCH") << endl;
+    }
+
+    cout << runs << " runs, " << failures << " mismatches" << endl;
+    return failures == 0 ? 0 : 1;
+}
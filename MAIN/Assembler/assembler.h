@@ -0,0 +1,1307 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include "symbol_table.h"
+#include "literal_pool.h"
+#include "intermediate_code.h"
+#include "source_reader.h"
+#include "opcode_table.h"
+#include "thread_pool.h"
+#include "output_writer.h"
+#include "line_scanner.h"
+#include "optimizer.h"
+
+using namespace std;
+
+// One row of the machine code listing
+struct MachineInstruction
+{
+    int lc;
+    int opcode;
+    int reg;          // 0 when there is no register operand ("00")
+    int operand;      // address or register code
+    bool has_operand; // false prints "00"
+};
+
+enum class LinkType : uint8_t
+{
+    EXTERN, // used here, defined in another module
+    ENTRY   // defined here, visible to other modules
+};
+
+// EXTERN/ENTRY directive, in source order
+struct LinkRecord
+{
+    string name;
+    LinkType type;
+};
+
+// Everything an assembly run produces
+struct ObjectModule
+{
+    SymbolTable symbol_table;
+    LiteralTable literal_table;
+    vector<int> pool_table; // 1-based index of the first literal of every non-empty pool
+    vector<ICRecord> intermediate_code;
+    vector<MachineInstruction> machine_code;
+    vector<LinkRecord> link_records;
+};
+
+struct AssemblerOptions
+{
+    // Read the source once and backpatch forward references instead of
+    // running pass 1 and pass 2
+    bool single_pass = false;
+
+    // Two-pass mode: run both passes in chunks on this many threads
+    int threads = 1;
+
+    // Two-pass mode: run the peephole optimizer over the intermediate code
+    // before generating machine code
+    bool optimize = false;
+
+    // Two-pass mode: thread jumps through chains of unconditional jumps
+    // before generating machine code (and before the peephole optimizer)
+    bool thread_jumps = false;
+
+    // Two-pass mode: remove unreachable code and unreferenced DC/DS
+    // declarations before generating machine code (after jump threading)
+    bool remove_dead = false;
+
+    // Any optimizer stage is on
+    bool optimizing() const { return optimize || thread_jumps || remove_dead; }
+};
+
+// Assembler for the IS/AD/DL instruction set. All state of a run lives in
+// the object, so separate Assembler objects can assemble different sources
+// on different threads at the same time, and an object can be reused for
+// any number of sources one after the other.
+class Assembler
+{
+    friend class IncrementalAssembler;
+
+private:
+    // Machine OpCode Table, perfect-hashed at compile time
+    static constexpr const PerfectHashTable<OpcodeInfo, 64> &mot = assembler_mot;
+
+    AssemblerOptions options;
+    unique_ptr<ThreadPool> pool; // for the chunked passes, while a run is going on
+
+    SymbolTable symbol_table;
+    LiteralTable literal_table;
+    vector<int> pool_table;
+    vector<ICRecord> intermediate_code;
+    vector<MachineInstruction> machine_code;
+    vector<LinkRecord> link_records;
+    OptimizerReport optimizer_report;
+
+    int lc = 0;
+    size_t pool_number = 0; // next literal pool to be flushed
+
+    // Single-pass backpatching: chains of unresolved references, threaded
+    // through next_ref (one slot per machine_code row, -1 ends a chain)
+    vector<int> next_ref;
+    vector<int> symbol_chains;  // head of the unresolved reference chain per symbol
+    vector<int> literal_chains; // head of the unresolved reference chain per literal
+
+    void reset()
+    {
+        symbol_table.clear();
+        literal_table.clear();
+        pool_table.clear();
+        intermediate_code.clear();
+        machine_code.clear();
+        link_records.clear();
+        optimizer_report = OptimizerReport();
+        next_ref.clear();
+        symbol_chains.clear();
+        literal_chains.clear();
+        lc = 0;
+        pool_number = 0;
+    }
+
+    // Both passes can work on chunks of the source in parallel. A chunk is
+    // split into segments wherever the LC it continues with is not known
+    // locally; LCs inside a segment are kept relative to its start and
+    // rebased once the segments before it have been summed up.
+    struct LcSegment
+    {
+        enum Start : uint8_t
+        {
+            CONTINUE, // chunk start, LC carries over from the previous chunk
+            SET,      // START (and ORIGIN in pass 2), LC is value
+            FLUSH     // after LTORG/END in pass 2, LC is past the flushed literal pool
+        };
+
+        Start start;
+        int value;
+        size_t first_record; // first record of the segment (pass 2)
+        int length = 0;      // LC advance over the segment
+        int base = 0;        // LC at the segment start once resolved
+    };
+
+    struct LabelDefinition
+    {
+        string_view name;
+        size_t segment;
+        int offset; // LC relative to the segment start
+    };
+
+    struct Pass1Chunk
+    {
+        string_view text;
+        vector<LcSegment> segments = {{LcSegment::CONTINUE, 0, 0}};
+        vector<LabelDefinition> labels;
+        vector<string_view> literals; // an empty view marks the end of a pool
+        vector<int> addresses; // of labels, after the second sweep
+        int lc = 0;
+    };
+
+    // What pass 1 takes from one line
+    struct Pass1Line
+    {
+        enum Effect : uint8_t
+        {
+            ADD, // LC advances by value
+            SET  // START, LC is value
+        };
+
+        string_view label;
+        string_view literal;       // literal operand, or a literal alone on the line
+        bool literal_only = false; // the line is just a literal
+        bool closes_pool = false;  // LTORG/END
+        Effect effect = ADD;
+        int value = 0;
+    };
+
+    Pass1Line scanLine(string_view line) const
+    {
+        return scanLine(tokenizeLine(line));
+    }
+
+    Pass1Line scanLine(const TokenizedLine &line) const
+    {
+        Pass1Line decoded;
+        string_view tokens[4] = {line.tokens[0], line.tokens[1], line.tokens[2], line.tokens[3]};
+
+        // Check if the first token is a mnemonic or label
+        if (mot.find(tokens[0]) == nullptr && !tokens[0].empty())
+        {
+            // Check if the symbol is a literal
+            if (tokens[0].find("='") == 0)
+            {
+                // If it's a literal, skip adding to the symbol table
+                decoded.literal = tokens[0];
+                decoded.literal_only = true;
+                return decoded;
+            }
+
+            decoded.label = tokens[0];
+
+            tokens[0] = tokens[1];
+            tokens[1] = tokens[2];
+            tokens[2] = tokens[3];
+            tokens[3] = string_view();
+        }
+
+        // Handle mnemonics and literals
+        string_view mnemonic = tokens[0];
+        const OpcodeInfo *entry = mot.find(mnemonic);
+        if (mnemonic == "START")
+        {
+            decoded.effect = Pass1Line::SET;
+            decoded.value = toInt(tokens[1]);
+        }
+        else if (mnemonic == "EXTERN" || mnemonic == "ENTRY")
+        {
+            // Link directives take no space
+        }
+        else if (mnemonic == "DS")
+        {
+            decoded.value = toInt(tokens[1]);
+        }
+        else if (mnemonic == "DC")
+        {
+            decoded.value = 1;
+        }
+        else if (entry != nullptr)
+        {
+            decoded.value = entry->op_class == OpClass::IS ? 2 : 1;
+
+            // Check for literals in the operands
+            if (tokens[2].find("='") == 0)
+            {
+                decoded.literal = tokens[2];
+            }
+
+            // LTORG and END flush the pool, later literals start a new one
+            decoded.closes_pool = mnemonic == "LTORG" || mnemonic == "END";
+        }
+        return decoded;
+    }
+
+    void firstPass(string_view line)
+    {
+        firstPass(tokenizeLine(line));
+    }
+
+    void firstPass(const TokenizedLine &line)
+    {
+        STATS_LINE(FIRST_PASS);
+        Pass1Line decoded = scanLine(line);
+        if (decoded.literal_only)
+        {
+            addLiteral(decoded.literal);
+            return;
+        }
+
+        if (!decoded.label.empty())
+        {
+            int symbol_index = symbol_table.find(decoded.label);
+            if (symbol_index != 0)
+            {
+                auto &sym = symbol_table[symbol_index - 1];
+                if (sym.second == -1)
+                {
+                    sym.second = lc;
+                }
+                return;
+            }
+
+            symbol_table.add(decoded.label, lc);
+        }
+
+        if (decoded.effect == Pass1Line::SET)
+        {
+            lc = decoded.value;
+        }
+        else
+        {
+            lc += decoded.value;
+        }
+
+        if (!decoded.literal.empty())
+        {
+            addLiteral(decoded.literal);
+        }
+        if (decoded.closes_pool)
+        {
+            literal_table.closePool();
+        }
+    }
+
+    // LC deltas of one chunk for the parallel pass 1, with labels and
+    // literals collected instead of entered
+    void scanChunk(Pass1Chunk &chunk) const
+    {
+        LineScanner scanner(chunk.text);
+        while (const TokenizedLine *line = scanner.next())
+        {
+            STATS_LINE(FIRST_PASS);
+            Pass1Line decoded = scanLine(*line);
+            if (decoded.literal_only)
+            {
+                chunk.literals.push_back(decoded.literal);
+                continue;
+            }
+
+            if (!decoded.label.empty())
+            {
+                chunk.labels.push_back({decoded.label, chunk.segments.size() - 1, chunk.lc});
+            }
+
+            if (decoded.effect == Pass1Line::SET)
+            {
+                chunk.segments.back().length = chunk.lc;
+                chunk.segments.push_back({LcSegment::SET, decoded.value, 0});
+                chunk.lc = 0;
+            }
+            else
+            {
+                chunk.lc += decoded.value;
+            }
+
+            if (!decoded.literal.empty())
+            {
+                chunk.literals.push_back(decoded.literal);
+            }
+            if (decoded.closes_pool)
+            {
+                chunk.literals.push_back(string_view());
+            }
+        }
+        chunk.segments.back().length = chunk.lc;
+    }
+
+    // Pass 1 over chunks on the pool: every chunk sums up its LC deltas, a
+    // prefix scan over the chunk summaries gives each segment its base LC, and
+    // a second parallel sweep turns label offsets into addresses. Labels and
+    // literals are then entered in source order so the table indices match
+    // the sequential pass.
+    void firstPass(string_view source, ThreadPool &pool)
+    {
+        vector<Pass1Chunk> chunks;
+        for (string_view text : splitChunks(source, pool.size() * 4))
+        {
+            chunks.emplace_back();
+            chunks.back().text = text;
+        }
+
+        for (auto &chunk : chunks)
+        {
+            pool.submit([this, &chunk]
+                        { scanChunk(chunk); });
+        }
+        pool.wait();
+
+        // Prefix scan over the segment lengths
+        for (auto &chunk : chunks)
+        {
+            for (auto &segment : chunk.segments)
+            {
+                if (segment.start == LcSegment::SET)
+                {
+                    lc = segment.value;
+                }
+                segment.base = lc;
+                lc += segment.length;
+            }
+        }
+
+        for (auto &chunk : chunks)
+        {
+            pool.submit([&chunk]
+                        {
+                            chunk.addresses.reserve(chunk.labels.size());
+                            for (const auto &label : chunk.labels)
+                            {
+                                chunk.addresses.push_back(chunk.segments[label.segment].base + label.offset);
+                            } });
+        }
+        pool.wait();
+
+        for (const auto &chunk : chunks)
+        {
+            for (size_t i = 0; i < chunk.labels.size(); i++)
+            {
+                if (symbol_table.find(chunk.labels[i].name) != 0)
+                {
+                    // A label defined twice drops the LC of its line in the
+                    // sequential pass, which shifts every later address, so
+                    // leave such sources to it
+                    symbol_table.clear();
+                    literal_table.clear();
+                    literal_chains.clear();
+                    lc = 0;
+
+                    LineScanner scanner(source);
+                    while (const TokenizedLine *line = scanner.next())
+                    {
+                        firstPass(*line);
+                    }
+                    return;
+                }
+                symbol_table.add(chunk.labels[i].name, chunk.addresses[i]);
+            }
+        }
+
+        for (const auto &chunk : chunks)
+        {
+            for (string_view literal : chunk.literals)
+            {
+                if (literal.empty())
+                {
+                    literal_table.closePool();
+                }
+                else
+                {
+                    addLiteral(literal);
+                }
+            }
+        }
+    }
+
+    // Returns the 1-based index of the literal in the open pool, adding it if
+    // the pool does not have it yet
+    int addLiteral(string_view value)
+    {
+        int literal_number = literal_table.find(literal_table.openPool(), value);
+        if (literal_number == 0)
+        {
+            literal_number = literal_table.add(value);
+            literal_chains.push_back(-1);
+        }
+        return literal_number;
+    }
+
+    // Assigns addresses to the literals of the next pool at LTORG/END and
+    // returns their 0-based index range
+    pair<size_t, size_t> flushLiteralPool()
+    {
+        // In single-pass mode the pool is still open
+        if (pool_number == literal_table.openPool())
+        {
+            literal_table.closePool();
+        }
+
+        auto range = literal_table.poolRange(pool_number++);
+        if (range.first < range.second)
+        {
+            pool_table.push_back(range.first + 1); // +1 for 1-based index
+        }
+
+        for (size_t i = range.first; i < range.second; i++)
+        {
+            literal_table[i].address = lc;
+            lc++;
+        }
+        return range;
+    }
+
+    // Pass 2 translates chunks of lines independently, possibly on several
+    // threads at once. Inside a chunk the LC of a record is kept relative to
+    // the start of its segment, because the LC a chunk starts at and the size
+    // of a literal pool flushed at LTORG/END are only known once everything
+    // before them is done. Operands that need a new symbol entry are deferred
+    // too, so the shared tables are only read while translating, and so are
+    // literals, whose pool is only known once the LTORGs before them are counted.
+    struct DeferredOperand
+    {
+        enum Kind : uint8_t
+        {
+            SYMBOL,        // register form, a new symbol is added with address -1
+            SYMBOL_AT_LC,  // single operand, a new symbol is added at the instruction's LC
+            SYMBOL_COUNT,  // no operand, refers to the last symbol
+            LITERAL
+        };
+
+        size_t record;
+        string_view name;
+        Kind kind;
+    };
+
+    struct Pass2Chunk
+    {
+        string_view text;
+        vector<ICRecord> records;
+        vector<LcSegment> segments = {{LcSegment::CONTINUE, 0, 0}};
+        vector<DeferredOperand> deferred;
+        vector<LinkRecord> links;
+        int lc = 0;
+
+        void startSegment(LcSegment::Start start, int value)
+        {
+            segments.back().length = lc;
+            segments.push_back({start, value, records.size()});
+            lc = 0;
+        }
+    };
+
+    void secondPass(string_view line, Pass2Chunk &chunk) const
+    {
+        secondPass(tokenizeLine(line), chunk);
+    }
+
+    void secondPass(const TokenizedLine &line, Pass2Chunk &chunk) const
+    {
+        STATS_LINE(SECOND_PASS);
+        if (line.count == 0)
+        {
+            return; // Blank line
+        }
+        string_view tokens[4] = {line.tokens[0], line.tokens[1], line.tokens[2], line.tokens[3]};
+
+        // Check for label (when the first token is not an opcode)
+        const OpcodeInfo *entry = mot.find(tokens[0]);
+        if (entry == nullptr)
+        {
+            entry = mot.find(tokens[1]);
+            if (entry != nullptr)
+            {
+                // Remove the label
+                tokens[0] = tokens[1];
+                tokens[1] = tokens[2];
+                tokens[2] = tokens[3];
+                tokens[3] = string_view();
+            }
+        }
+
+        string_view mnemonic = tokens[0];
+        vector<ICRecord> &intermediate_code = chunk.records;
+
+        if (mnemonic == "START" || mnemonic == "ORIGIN")
+        {
+            int address = toInt(tokens[1]);
+            chunk.startSegment(LcSegment::SET, address);
+            intermediate_code.push_back({0, OpClass::AD, entry->opcode, 0, OperandKind::CONSTANT, address});
+        }
+        else if (mnemonic == "END" || mnemonic == "LTORG")
+        {
+            intermediate_code.push_back({chunk.lc, OpClass::AD, entry->opcode, 0, OperandKind::NONE, 0});
+            chunk.startSegment(LcSegment::FLUSH, 0);
+        }
+        else if (mnemonic == "EXTERN" || mnemonic == "ENTRY")
+        {
+            intermediate_code.push_back({chunk.lc, OpClass::AD, entry->opcode, 0, OperandKind::NONE, 0});
+            chunk.links.push_back({string(tokens[1]), mnemonic == "EXTERN" ? LinkType::EXTERN : LinkType::ENTRY});
+        }
+        else if (mnemonic == "DS")
+        {
+            int size = toInt(tokens[1]);
+            intermediate_code.push_back({chunk.lc, OpClass::DL, 2, 0, OperandKind::CONSTANT, size});
+            chunk.lc += size;
+        }
+        else if (mnemonic == "DC")
+        {
+            intermediate_code.push_back({chunk.lc, OpClass::DL, 1, 0, OperandKind::CONSTANT, toInt(tokens[1])});
+            chunk.lc++;
+        }
+        else if (entry != nullptr)
+        {
+            string_view operand1 = tokens[1];
+            string_view operand2 = tokens[2];
+
+            ICRecord ic = {chunk.lc, OpClass::IS, entry->opcode, 0, OperandKind::NONE, 0};
+            size_t record = intermediate_code.size();
+
+            const int *reg1 = register_table.find(operand1);
+            if (reg1 != nullptr)
+            {
+                ic.reg = *reg1;
+
+                if (!operand2.empty())
+                {
+                    const int *reg2 = register_table.find(operand2);
+                    if (reg2 != nullptr)
+                    {
+                        ic.kind = OperandKind::REGISTER;
+                        ic.value = *reg2;
+                    }
+                    else if (operand2.find("='") == 0)
+                    {
+                        ic.kind = OperandKind::LITERAL;
+                        chunk.deferred.push_back({record, operand2, DeferredOperand::LITERAL});
+                    }
+                    else
+                    {
+                        ic.kind = OperandKind::SYMBOL;
+                        ic.value = symbol_table.find(operand2);
+                        if (ic.value == 0)
+                        {
+                            chunk.deferred.push_back({record, operand2, DeferredOperand::SYMBOL});
+                        }
+                    }
+                }
+            }
+            else
+            {
+                ic.kind = OperandKind::SYMBOL;
+                ic.value = symbol_table.find(operand1);
+                if (ic.value == 0)
+                {
+                    chunk.deferred.push_back({record, operand1, operand1.empty() ? DeferredOperand::SYMBOL_COUNT : DeferredOperand::SYMBOL_AT_LC});
+                }
+            }
+
+            intermediate_code.push_back(ic);
+            chunk.lc += 2;
+        }
+    }
+
+    // Walks the segments of a translated chunk in source order: fixes the LC
+    // each one starts at, flushes literal pools at LTORG/END and adds the
+    // deferred symbols and literals, which keeps table indices exactly as a
+    // line-by-line pass 2 would assign them. A literal is looked up in the
+    // pool that the next flush will place.
+    void resolveChunk(Pass2Chunk &chunk)
+    {
+        chunk.segments.back().length = chunk.lc;
+
+        size_t next = 0;
+        for (size_t s = 0; s < chunk.segments.size(); s++)
+        {
+            LcSegment &segment = chunk.segments[s];
+            if (segment.start == LcSegment::SET)
+            {
+                lc = segment.value;
+            }
+            else if (segment.start == LcSegment::FLUSH)
+            {
+                flushLiteralPool();
+            }
+            segment.base = lc;
+
+            size_t end_record = s + 1 < chunk.segments.size() ? chunk.segments[s + 1].first_record : chunk.records.size();
+            for (; next < chunk.deferred.size() && chunk.deferred[next].record < end_record; next++)
+            {
+                const DeferredOperand &operand = chunk.deferred[next];
+                ICRecord &ic = chunk.records[operand.record];
+
+                if (operand.kind == DeferredOperand::LITERAL)
+                {
+                    ic.value = literal_table.find(pool_number, operand.name);
+                    if (ic.value == 0)
+                    {
+                        // Only on a line pass 1 skipped
+                        ic.value = addLiteral(operand.name);
+                    }
+                    continue;
+                }
+
+                int symbol_index = symbol_table.find(operand.name);
+                if (symbol_index == 0)
+                {
+                    if (operand.kind == DeferredOperand::SYMBOL)
+                    {
+                        symbol_index = symbol_table.add(operand.name, -1);
+                    }
+                    else
+                    {
+                        if (operand.kind == DeferredOperand::SYMBOL_AT_LC)
+                        {
+                            symbol_table.add(operand.name, segment.base + ic.lc);
+                        }
+                        symbol_index = symbol_table.size();
+                    }
+                }
+                ic.value = symbol_index;
+            }
+
+            lc = segment.base + segment.length;
+        }
+
+        link_records.insert(link_records.end(), chunk.links.begin(), chunk.links.end());
+    }
+
+    // Moves the records of a resolved chunk to their place in intermediate_code
+    void placeChunk(Pass2Chunk &chunk, size_t offset)
+    {
+        size_t s = 0;
+        for (size_t i = 0; i < chunk.records.size(); i++)
+        {
+            while (s + 1 < chunk.segments.size() && chunk.segments[s + 1].first_record <= i)
+            {
+                s++;
+            }
+            ICRecord &ic = intermediate_code[offset + i];
+            ic = chunk.records[i];
+            ic.lc += chunk.segments[s].base;
+        }
+        chunk.records = vector<ICRecord>();
+    }
+
+    void secondPass(string_view source, ThreadPool *pool)
+    {
+        size_t count = pool != nullptr ? pool->size() * 4 : 1;
+        vector<Pass2Chunk> chunks;
+        for (string_view text : splitChunks(source, count))
+        {
+            chunks.emplace_back();
+            chunks.back().text = text;
+        }
+
+        // Translate every chunk against the tables from pass 1
+        auto translate = [this](Pass2Chunk &chunk)
+        {
+            LineScanner scanner(chunk.text);
+            while (const TokenizedLine *line = scanner.next())
+            {
+                secondPass(*line, chunk);
+            }
+        };
+
+        if (pool == nullptr)
+        {
+            for (auto &chunk : chunks)
+            {
+                translate(chunk);
+            }
+        }
+        else
+        {
+            for (auto &chunk : chunks)
+            {
+                pool->submit([&translate, &chunk]
+                             { translate(chunk); });
+            }
+            pool->wait();
+        }
+
+        // Short sequential fix-up in source order
+        vector<size_t> offsets;
+        size_t total = 0;
+        for (auto &chunk : chunks)
+        {
+            resolveChunk(chunk);
+            offsets.push_back(total);
+            total += chunk.records.size();
+        }
+
+        // Concatenate
+        intermediate_code.resize(total);
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            if (pool == nullptr)
+            {
+                placeChunk(chunks[i], offsets[i]);
+            }
+            else
+            {
+                pool->submit([this, &chunks, &offsets, i]
+                             { placeChunk(chunks[i], offsets[i]); });
+            }
+        }
+        if (pool != nullptr)
+        {
+            pool->wait();
+        }
+    }
+
+    // Listing row of an intermediate code record
+    MachineInstruction machineInstruction(const ICRecord &entry) const
+    {
+        MachineInstruction instruction = {entry.lc, entry.opcode, 0, 0, false};
+
+        // The second operand is only encoded after a register operand
+        if (entry.reg != 0)
+        {
+            instruction.reg = entry.reg;
+            instruction.has_operand = true;
+
+            if (entry.kind == OperandKind::SYMBOL)
+            {
+                // Operand2 is a symbol, look it up in the symbol table
+                instruction.operand = symbol_table[entry.value - 1].second;
+            }
+            else if (entry.kind == OperandKind::LITERAL)
+            {
+                // Operand2 is a literal, look it up in the literal table
+                instruction.operand = literal_table[entry.value - 1].address;
+            }
+            else if (entry.kind == OperandKind::REGISTER)
+            {
+                // Operand2 is also a register
+                instruction.operand = entry.value;
+            }
+            else
+            {
+                instruction.has_operand = false;
+            }
+        }
+        return instruction;
+    }
+
+    void generateMachineCode()
+    {
+        STATS_PHASE(MACHINE_CODE);
+        for (const auto &entry : intermediate_code)
+        {
+            machine_code.push_back(machineInstruction(entry));
+        }
+    }
+
+    // Single-pass mode: machine code is emitted while the source is read. An
+    // operand whose symbol or literal has no address yet is linked into a chain
+    // of unresolved references for that entry and patched once the address is
+    // known.
+    void emit(const MachineInstruction &instruction)
+    {
+        machine_code.push_back(instruction);
+        next_ref.push_back(-1);
+    }
+
+    void patchChain(int head, int address)
+    {
+        while (head != -1)
+        {
+            int next = next_ref[head];
+            machine_code[head].operand = address;
+            next_ref[head] = -1;
+            head = next;
+        }
+    }
+
+    // Points the operand of the last emitted instruction at an entry, or chains it
+    void referenceOperand(int address, vector<int> &chains, int index)
+    {
+        MachineInstruction &instruction = machine_code.back();
+        instruction.operand = address;
+        instruction.has_operand = true;
+        if (address == -1)
+        {
+            next_ref.back() = chains[index - 1];
+            chains[index - 1] = machine_code.size() - 1;
+        }
+    }
+
+    int lookupSymbol(string_view name)
+    {
+        int symbol_index = symbol_table.find(name);
+        if (symbol_index == 0)
+        {
+            symbol_index = symbol_table.add(name, -1);
+            symbol_chains.push_back(-1);
+        }
+        return symbol_index;
+    }
+
+    void singlePass(const TokenizedLine &line)
+    {
+        STATS_LINE(SINGLE_PASS);
+        if (line.count == 0)
+        {
+            return;
+        }
+        string_view tokens[4] = {line.tokens[0], line.tokens[1], line.tokens[2], line.tokens[3]};
+
+        // A label is defined at the current LC, which resolves its pending references
+        const OpcodeInfo *entry = mot.find(tokens[0]);
+        if (entry == nullptr && (entry = mot.find(tokens[1])) != nullptr)
+        {
+            int symbol_index = lookupSymbol(tokens[0]);
+            if (symbol_table[symbol_index - 1].second == -1)
+            {
+                symbol_table[symbol_index - 1].second = lc;
+                patchChain(symbol_chains[symbol_index - 1], lc);
+                symbol_chains[symbol_index - 1] = -1;
+            }
+            tokens[0] = tokens[1];
+            tokens[1] = tokens[2];
+            tokens[2] = tokens[3];
+            tokens[3] = string_view();
+        }
+
+        string_view mnemonic = tokens[0];
+        if (entry == nullptr)
+        {
+            return;
+        }
+
+        int opcode = entry->opcode;
+        string_view operand1 = tokens[1];
+        string_view operand2 = tokens[2];
+
+        if (entry->op_class != OpClass::IS)
+        {
+            emit({lc, opcode, 0, 0, false});
+        }
+
+        if (mnemonic == "START" || mnemonic == "ORIGIN")
+        {
+            lc = toInt(operand1);
+            machine_code.back().lc = lc;
+            intermediate_code.push_back({lc, OpClass::AD, (uint8_t)opcode, 0, OperandKind::CONSTANT, lc});
+        }
+        else if (mnemonic == "END" || mnemonic == "LTORG")
+        {
+            intermediate_code.push_back({lc, OpClass::AD, (uint8_t)opcode, 0, OperandKind::NONE, 0});
+
+            auto range = flushLiteralPool();
+            for (size_t i = range.first; i < range.second; i++)
+            {
+                patchChain(literal_chains[i], literal_table[i].address);
+                literal_chains[i] = -1;
+            }
+        }
+        else if (mnemonic == "EXTERN" || mnemonic == "ENTRY")
+        {
+            intermediate_code.push_back({lc, OpClass::AD, (uint8_t)opcode, 0, OperandKind::NONE, 0});
+            link_records.push_back({string(operand1), mnemonic == "EXTERN" ? LinkType::EXTERN : LinkType::ENTRY});
+        }
+        else if (mnemonic == "DS")
+        {
+            int size = toInt(operand1);
+            intermediate_code.push_back({lc, OpClass::DL, 2, 0, OperandKind::CONSTANT, size});
+            lc += size;
+        }
+        else if (mnemonic == "DC")
+        {
+            intermediate_code.push_back({lc, OpClass::DL, 1, 0, OperandKind::CONSTANT, toInt(operand1)});
+            lc++;
+        }
+        else
+        {
+            ICRecord ic = {lc, OpClass::IS, (uint8_t)opcode, 0, OperandKind::NONE, 0};
+            emit({lc, opcode, 0, 0, false});
+
+            const int *reg1 = register_table.find(operand1);
+            if (reg1 != nullptr)
+            {
+                ic.reg = *reg1;
+                machine_code.back().reg = ic.reg;
+
+                const int *reg2 = register_table.find(operand2);
+                if (reg2 != nullptr)
+                {
+                    ic.kind = OperandKind::REGISTER;
+                    ic.value = *reg2;
+                    machine_code.back().operand = ic.value;
+                    machine_code.back().has_operand = true;
+                }
+                else if (operand2.find("='") == 0)
+                {
+                    int literal_number = addLiteral(operand2);
+                    ic.kind = OperandKind::LITERAL;
+                    ic.value = literal_number;
+                    referenceOperand(literal_table[literal_number - 1].address, literal_chains, literal_number);
+                }
+                else if (!operand2.empty())
+                {
+                    int symbol_index = lookupSymbol(operand2);
+                    ic.kind = OperandKind::SYMBOL;
+                    ic.value = symbol_index;
+                    referenceOperand(symbol_table[symbol_index - 1].second, symbol_chains, symbol_index);
+                }
+            }
+            else if (!operand1.empty())
+            {
+                // Single symbol operand (JMP, JZ, ...)
+                ic.kind = OperandKind::SYMBOL;
+                ic.value = lookupSymbol(operand1);
+            }
+
+            intermediate_code.push_back(ic);
+            lc += 2;
+        }
+    }
+
+public:
+    Assembler(AssemblerOptions options = AssemblerOptions()) : options(options) {}
+
+    // A two-pass run can also be driven one phase at a time, for instance to
+    // time the phases: begin(), runFirstPass(), runSecondPass(),
+    // runOptimizer(), runMachineCode() and finish() in this order do what
+    // assemble() does
+    void begin()
+    {
+        reset();
+        pool.reset();
+        if (!options.single_pass && options.threads > 1)
+        {
+            pool = make_unique<ThreadPool>(options.threads);
+        }
+    }
+
+    void runFirstPass(string_view source)
+    {
+        STATS_PHASE(FIRST_PASS);
+        if (pool != nullptr)
+        {
+            firstPass(source, *pool);
+            return;
+        }
+
+        LineScanner scanner(source);
+        while (const TokenizedLine *line = scanner.next())
+        {
+            firstPass(*line);
+        }
+    }
+
+    void runSecondPass(string_view source)
+    {
+        STATS_PHASE(SECOND_PASS);
+        secondPass(source, pool.get());
+    }
+
+    // Runs the optimizer stages turned on in options, if any
+    void runOptimizer()
+    {
+        if (!options.optimizing())
+        {
+            return;
+        }
+        STATS_PHASE(OPTIMIZE);
+        Optimizer optimizer(intermediate_code, symbol_table, literal_table);
+        if (options.thread_jumps)
+        {
+            optimizer.threadJumps();
+        }
+        if (options.remove_dead)
+        {
+            vector<string_view> exported;
+            for (const auto &record : link_records)
+            {
+                if (record.type == LinkType::ENTRY)
+                {
+                    exported.push_back(record.name);
+                }
+            }
+            optimizer.removeDeadCode(exported);
+        }
+        if (options.optimize)
+        {
+            optimizer.peephole();
+        }
+        optimizer_report = optimizer.report();
+    }
+
+    void runMachineCode()
+    {
+        generateMachineCode();
+    }
+
+    // What the optimizer did in the last run
+    const OptimizerReport &optimizerReport() const { return optimizer_report; }
+
+    ObjectModule finish()
+    {
+        pool.reset();
+        return {move(symbol_table), move(literal_table), move(pool_table),
+                move(intermediate_code), move(machine_code), move(link_records)};
+    }
+
+    ObjectModule assemble(string_view source)
+    {
+        begin();
+
+        if (options.single_pass)
+        {
+            STATS_PHASE(SINGLE_PASS);
+            LineScanner scanner(source);
+            while (const TokenizedLine *line = scanner.next())
+            {
+                singlePass(*line);
+            }
+        }
+        else
+        {
+            runFirstPass(source);
+            runSecondPass(source);
+            runOptimizer();
+            runMachineCode();
+        }
+
+        return finish();
+    }
+};
+
+// Assembles source with a private Assembler, so it can be called from any
+// number of threads at once
+inline ObjectModule assemble(string_view source, AssemblerOptions options = AssemblerOptions())
+{
+    Assembler assembler(options);
+    return assembler.assemble(source);
+}
+
+// Writes an IC record in its "(IS,1) (R,1) (S,3)" form
+inline void writeIC(OutputWriter &out, const ICRecord &ic)
+{
+    out.put('(');
+    out.write(opClassName(ic.op_class));
+    out.put(',');
+    out.writeInt(ic.opcode);
+    out.put(')');
+
+    if (ic.reg != 0)
+    {
+        out.write(" (R,");
+        out.writeInt(ic.reg);
+        out.put(')');
+    }
+
+    const char *prefix = nullptr;
+    switch (ic.kind)
+    {
+    case OperandKind::REGISTER:
+        prefix = " (R,";
+        break;
+    case OperandKind::SYMBOL:
+        prefix = " (S,";
+        break;
+    case OperandKind::LITERAL:
+        prefix = " (L,";
+        break;
+    case OperandKind::CONSTANT:
+        prefix = " (C,";
+        break;
+    default:
+        return;
+    }
+    out.write(prefix);
+    out.writeInt(ic.value);
+    out.put(')');
+}
+
+// Writes the symbol, literal and pool tables, the intermediate code and the
+// machine code. With tables set to false only the machine code is written.
+inline void printListing(const ObjectModule &module, OutputWriter &out, bool tables = true)
+{
+    STATS_PHASE(OUTPUT);
+    if (tables)
+    {
+        // Output Symbol Table
+        out.write("\nSymbol Table:\n");
+        out.column("Symbol", 15);
+        out.column("Address", 10);
+        out.newline();
+        out.fill('-', 25);
+        out.newline();
+
+        for (const auto &entry : module.symbol_table)
+        {
+            out.column(entry.first, 15);
+            out.column(entry.second, 10);
+            out.newline();
+        }
+
+        // Output Literal Table
+        out.write("\nLiteral Table:\n");
+        out.write("Index\tLiteral\tAddress\n");
+        for (size_t i = 0; i < module.literal_table.size(); i++)
+        {
+            out.writeInt(i);
+            out.put('\t');
+            out.write(module.literal_table[i].value);
+            out.put('\t');
+            out.writeInt(module.literal_table[i].address);
+            out.newline();
+        }
+
+        // Output Pool Table
+        out.write("\nPool Table:\n");
+        for (int index : module.pool_table)
+        {
+            out.writeInt(index);
+            out.newline();
+        }
+
+        // Output Link Records
+        if (!module.link_records.empty())
+        {
+            out.write("\nLink Records:\n");
+            out.column("Symbol", 15);
+            out.write("Type\n");
+            out.fill('-', 25);
+            out.newline();
+
+            for (const auto &record : module.link_records)
+            {
+                out.column(record.name, 15);
+                out.write(record.type == LinkType::EXTERN ? "EXTERN\n" : "ENTRY\n");
+            }
+        }
+
+        // Output Intermediate Code
+        out.write("\nIntermediate Code:\n");
+        out.column("LC", 8);
+        out.write("IC\n");
+        out.fill('-', 30);
+        out.newline();
+
+        for (const auto &ic : module.intermediate_code)
+        {
+            out.column(ic.lc, 8);
+            writeIC(out, ic);
+            out.newline();
+        }
+
+        out.newline();
+    }
+
+    out.write("Machine Code\n");
+    out.column("LC", 8);
+    out.column("OPCODE", 10);
+    out.column("OP1", 6);
+    out.write("OP2\n");
+    out.fill('-', 30); // Divider line
+    out.newline();
+
+    for (const auto &instruction : module.machine_code)
+    {
+        out.column(instruction.lc, 8);
+        out.column(instruction.opcode, 10);
+        if (instruction.reg != 0)
+        {
+            out.column(instruction.reg, 6);
+        }
+        else
+        {
+            out.column("00", 6);
+        }
+        if (instruction.has_operand)
+        {
+            out.writeInt(instruction.operand);
+        }
+        else
+        {
+            out.write("00");
+        }
+        out.newline();
+    }
+}
+
+// Writes what the optimizer removed, per rule, to stderr
+inline void printOptimizerReport(const OptimizerReport &report)
+{
+    OutputWriter err(2);
+    err.write("Optimizer removed ");
+    err.writeInt(report.removed);
+    err.write(" statements (");
+    err.writeInt(report.words);
+    err.write(" words)\n");
+    if (report.threaded > 0)
+    {
+        err.write("Optimizer threaded ");
+        err.writeInt(report.threaded);
+        err.write(" jumps\n");
+    }
+    for (const auto &rule : report.rules)
+    {
+        err.write("  ");
+        err.column(rule.rule, 24);
+        err.writeInt(rule.removed);
+        err.newline();
+    }
+}
+
+// Writes the instrumentation counters as one JSON object. Does nothing unless
+// built with -DASSEMBLER_STATS.
+inline void writeStatsJson(OutputWriter &out)
+{
+#ifdef ASSEMBLER_STATS
+    // Read everything first, the JSON itself counts as bytes written
+    const char *phase_names[] = {"single_pass", "first_pass", "second_pass", "optimize", "machine_code", "output"};
+    uint64_t phase_ns[(int)Phase::COUNT], phase_lines[(int)Phase::COUNT];
+    for (int phase = 0; phase < (int)Phase::COUNT; phase++)
+    {
+        phase_ns[phase] = assembler_stats.phases[phase].ns.load();
+        phase_lines[phase] = assembler_stats.phases[phase].lines.load();
+    }
+    pair<const char *, uint64_t> counters[] = {
+        {"symbol_lookups", assembler_stats.symbol_lookups.load()},
+        {"name_probes", assembler_stats.name_probes.load()},
+        {"literal_lookups", assembler_stats.literal_lookups.load()},
+        {"literal_probes", assembler_stats.literal_probes.load()},
+        {"allocations", allocation_count.load()},
+        {"allocation_bytes", allocation_bytes.load()},
+        {"bytes_written", assembler_stats.bytes_written.load()}};
+
+    out.write("{\n  \"phases\": {\n");
+    for (int phase = 0; phase < (int)Phase::COUNT; phase++)
+    {
+        out.write("    \"");
+        out.write(phase_names[phase]);
+        out.write("\": {\"ns\": ");
+        out.writeInt(phase_ns[phase]);
+        out.write(", \"lines\": ");
+        out.writeInt(phase_lines[phase]);
+        out.write(phase + 1 < (int)Phase::COUNT ? "},\n" : "}\n");
+    }
+    out.write("  }");
+    for (const auto &counter : counters)
+    {
+        out.write(",\n  \"");
+        out.write(counter.first);
+        out.write("\": ");
+        out.writeInt(counter.second);
+    }
+    out.write("\n}\n");
+#else
+    (void)out;
+#endif
+}
@@ -0,0 +1,329 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/resource.h>
+
+// Counts allocations through the operator new of stats.h
+#define ASSEMBLER_COUNT_ALLOCATIONS
+#include "assembler.h"
+#include "incremental.h"
+#include "source_reader.h"
+#include "output_writer.h"
+#include "program_generator.h"
+
+using namespace std;
+
+// End-to-end assembler benchmark on generated programs.
+// Every size is written to a temporary file and then timed phase by phase:
+// reading the file, pass 1, pass 2, machine code generation and writing the
+// full listing to /dev/null. Allocations are counted by the replacement
+// operator new of stats.h; peak RSS is the process high-water mark, so sizes
+// run in increasing order and each row shows the peak after that size.
+// Then chains of edits are assembled incrementally, each edit reusing the
+// cache of the one before, and checked against full assemblies.
+//
+// Usage: assembler_bench [--max-lines N] [--threads N] [--seed N]
+
+struct PhaseResult
+{
+    double ms = 0;
+    size_t allocations = 0;
+    size_t bytes = 0;
+};
+
+// Runs one phase and records its time and allocations
+template <typename Body>
+PhaseResult measure(Body phase)
+{
+    size_t count = allocation_count.load();
+    size_t bytes = allocation_bytes.load();
+    auto begin = chrono::steady_clock::now();
+    phase();
+    auto finish = chrono::steady_clock::now();
+    return {chrono::duration<double, milli>(finish - begin).count(),
+            allocation_count.load() - count, allocation_bytes.load() - bytes};
+}
+
+long peakRssKb()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+string joinLines(const vector<string> &lines)
+{
+    string source;
+    for (const string &line : lines)
+    {
+        source += line;
+        source += '\n';
+    }
+    return source;
+}
+
+// Whether two modules have the same code, machine code and tables
+bool sameModule(const ObjectModule &a, const ObjectModule &b)
+{
+    if (a.intermediate_code.size() != b.intermediate_code.size() || a.machine_code.size() != b.machine_code.size() ||
+        a.symbol_table.size() != b.symbol_table.size() || a.literal_table.size() != b.literal_table.size() ||
+        a.pool_table != b.pool_table || a.link_records.size() != b.link_records.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < a.intermediate_code.size(); i++)
+    {
+        const ICRecord &x = a.intermediate_code[i], &y = b.intermediate_code[i];
+        if (x.lc != y.lc || x.op_class != y.op_class || x.opcode != y.opcode || x.reg != y.reg ||
+            x.kind != y.kind || x.value != y.value)
+        {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.machine_code.size(); i++)
+    {
+        const MachineInstruction &x = a.machine_code[i], &y = b.machine_code[i];
+        if (x.lc != y.lc || x.opcode != y.opcode || x.reg != y.reg || x.has_operand != y.has_operand ||
+            (x.has_operand && x.operand != y.operand))
+        {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.symbol_table.size(); i++)
+    {
+        if (a.symbol_table[i] != b.symbol_table[i])
+        {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.literal_table.size(); i++)
+    {
+        if (a.literal_table[i].value != b.literal_table[i].value ||
+            a.literal_table[i].address != b.literal_table[i].address)
+        {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.link_records.size(); i++)
+    {
+        if (a.link_records[i].name != b.link_records[i].name || a.link_records[i].type != b.link_records[i].type)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Assembles every source of a chain of edits with one cache file and checks
+// each against a full assembly. Returns the number of the first edit that
+// does not match, or the chain's length.
+size_t checkIncremental(const vector<string> &sources, const string &cache_file)
+{
+    remove(cache_file.c_str());
+    size_t edit = 0;
+    for (; edit < sources.size(); edit++)
+    {
+        IncrementalAssembler incremental;
+        ObjectModule cached = incremental.assemble(sources[edit], cache_file);
+        if (!incremental.cacheWritten() || !sameModule(cached, assemble(sources[edit])))
+        {
+            break;
+        }
+    }
+    remove(cache_file.c_str());
+    return edit;
+}
+
+// Edits of a generated program: DS lines inserted and removed again, which
+// move every LC after them, instructions replaced in place, and a line added
+// before START and taken away, which moves the start of pass 2
+vector<string> editChain(const string &program, size_t edits)
+{
+    vector<string> lines;
+    string_view line;
+    size_t position = 0;
+    while (nextLine(program, position, line))
+    {
+        lines.push_back(string(line));
+    }
+
+    vector<string> sources = {joinLines(lines)};
+    size_t inserted = 1;
+    for (size_t edit = 0; edit < edits; edit++)
+    {
+        size_t at = 1 + (edit * 37 + 11) % (lines.size() - 2);
+        switch (edit % 4)
+        {
+        case 0:
+            lines.insert(lines.begin() + at, "DS " + to_string(edit % 3 + 1));
+            inserted = at;
+            break;
+        case 1:
+            // An instruction without a label, so the tables stay the same
+            for (; at + 1 < lines.size(); at++)
+            {
+                const string &text = lines[at];
+                if (text.rfind("MOVER ", 0) == 0 || text.rfind("ADD ", 0) == 0 || text.rfind("SUB ", 0) == 0)
+                {
+                    lines[at] = edit % 8 == 1 ? "MOVER AREG, BREG" : "SUB CREG, DREG";
+                    break;
+                }
+            }
+            break;
+        case 2:
+            lines.insert(lines.begin(), "DIV AREG, BREG");
+            inserted++;
+            break;
+        default:
+            lines.erase(lines.begin() + inserted);
+            lines.erase(lines.begin());
+            break;
+        }
+        sources.push_back(joinLines(lines));
+    }
+    return sources;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t max_lines = 10000000;
+    AssemblerOptions options;
+    uint64_t seed = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string arg = argv[i];
+        if (arg == "--max-lines")
+        {
+            max_lines = stoull(argv[i + 1]);
+        }
+        else if (arg == "--threads")
+        {
+            options.threads = stoi(argv[i + 1]);
+        }
+        else if (arg == "--seed")
+        {
+            seed = stoull(argv[i + 1]);
+        }
+    }
+
+    const size_t sizes[] = {1000, 10000, 100000, 1000000, 10000000};
+    const char *phase_names[] = {"read", "pass 1", "pass 2", "machine", "output"};
+    const string temp_file = "assembler_bench.tmp";
+
+    cout << left << setw(10) << "Lines" << setw(10) << "Phase"
+         << setw(12) << "Time (ms)" << setw(14) << "Lines/sec"
+         << setw(14) << "Allocations" << setw(14) << "Alloc (KiB)"
+         << setw(14) << "Peak RSS (KiB)" << endl;
+    cout << string(88, '-') << endl;
+
+    for (size_t lines : sizes)
+    {
+        if (lines > max_lines)
+        {
+            break;
+        }
+
+        {
+            ProgramGenerator generator(seed);
+            OutputWriter file(temp_file);
+            file.write(generator.generate(lines));
+            if (!file.flush())
+            {
+                cerr << "Error: Could not write " << temp_file << "!" << endl;
+                return 1;
+            }
+        }
+
+        SourceReader reader;
+        size_t line_count = 0;
+        Assembler assembler(options);
+        ObjectModule module;
+        PhaseResult results[5];
+
+        results[0] = measure([&]()
+        {
+            if (!reader.open(temp_file))
+            {
+                return;
+            }
+            string_view line;
+            size_t position = 0;
+            while (nextLine(reader.text(), position, line))
+            {
+                line_count++;
+            }
+        });
+        if (line_count == 0)
+        {
+            cerr << "Error: Could not read " << temp_file << "!" << endl;
+            return 1;
+        }
+
+        assembler.begin();
+        results[1] = measure([&]() { assembler.runFirstPass(reader.text()); });
+        results[2] = measure([&]() { assembler.runSecondPass(reader.text()); });
+        results[3] = measure([&]() { assembler.runMachineCode(); });
+        module = assembler.finish();
+        results[4] = measure([&]()
+        {
+            OutputWriter out("/dev/null");
+            printListing(module, out);
+            out.flush();
+        });
+
+        PhaseResult total;
+        for (int phase = 0; phase < 5; phase++)
+        {
+            const PhaseResult &result = results[phase];
+            total.ms += result.ms;
+            total.allocations += result.allocations;
+            total.bytes += result.bytes;
+            cout << left << setw(10) << line_count << setw(10) << phase_names[phase]
+                 << setw(12) << fixed << setprecision(2) << result.ms
+                 << setw(14) << setprecision(0) << line_count * 1000.0 / max(result.ms, 1e-3)
+                 << setw(14) << result.allocations << setw(14) << result.bytes / 1024
+                 << endl;
+        }
+        cout << left << setw(10) << line_count << setw(10) << "total"
+             << setw(12) << fixed << setprecision(2) << total.ms
+             << setw(14) << setprecision(0) << line_count * 1000.0 / max(total.ms, 1e-3)
+             << setw(14) << total.allocations << setw(14) << total.bytes / 1024
+             << setw(14) << peakRssKb() << endl;
+        cout << endl;
+    }
+
+    remove(temp_file.c_str());
+
+    // A START at the top keeps pass 2's LCs put only while pass 1 still
+    // ends where it did
+    vector<vector<string>> chains = {
+        {"L7 START 125\nDC 5\nDS 3\nJNZ L7\nEND\n",
+         "L7 START 125\nDC 5\nDS 3\nDS 1\nJNZ L7\nEND\n",
+         "DIV AREG, BREG\nL7 START 125\nDC 5\nDS 3\nDS 1\nJNZ L7\nEND\n"}};
+    for (uint64_t program = 0; program < 4; program++)
+    {
+        ProgramGenerator generator(seed + program);
+        chains.push_back(editChain(generator.generate(2000), 64));
+    }
+
+    size_t checked = 0;
+    for (size_t chain = 0; chain < chains.size(); chain++)
+    {
+        size_t matching = checkIncremental(chains[chain], "assembler_bench.cache");
+        if (matching != chains[chain].size())
+        {
+            cerr << "Error: incremental assembly of edit " << matching << " of chain " << chain
+                 << " does not match a full assembly!" << endl;
+            return 1;
+        }
+        checked += matching;
+    }
+    cout << "Incremental edits matching: " << checked << endl;
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#include <unordered_set>
+#include <chrono>
+#include <filesystem>
+#include "assembler.h"
+#include "source_reader.h"
+#include "thread_pool.h"
+#include "output_writer.h"
+#include "object_file.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// Outcome of assembling one source in the batch
+struct BatchResult
+{
+    string source;
+    string output;
+    string object; // empty unless --objects
+    size_t lines = 0;
+    bool ok = false;
+};
+
+void assembleFile(BatchResult &result, AssemblerOptions options, bool tables)
+{
+    SourceReader inputFile;
+    if (!inputFile.open(result.source))
+    {
+        return;
+    }
+
+    string_view text = inputFile.text();
+    result.lines = count(text.begin(), text.end(), '\n');
+    if (!text.empty() && text.back() != '\n')
+    {
+        result.lines++;
+    }
+
+    ObjectModule module = assemble(text, options);
+
+    OutputWriter outputFile(result.output);
+    printListing(module, outputFile, tables);
+    result.ok = outputFile.flush();
+
+    if (!result.object.empty())
+    {
+        result.ok = writeObjectFile(module, result.object) && result.ok;
+    }
+}
+
+// Usage: batch_assembler [--single-pass] [--jobs N] [--out DIR] [--no-listing] [--objects]
+//                        [--stats=json] source|directory...
+// Every source (or every .txt file of a directory) is assembled on a thread
+// pool and its listing is written to DIR/<name>.lst; --no-listing writes only
+// the machine code, --objects adds a binary DIR/<name>.obj and --stats=json
+// writes the counters of a -DASSEMBLER_STATS build, summed over all files,
+// to stderr
+int main(int argc, char *argv[])
+{
+    AssemblerOptions options;
+    bool tables = true;
+    bool objects = false;
+    bool stats_json = false;
+    size_t jobs = thread::hardware_concurrency();
+    fs::path output_dir = "batch_output";
+    vector<string> sources;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--single-pass")
+        {
+            options.single_pass = true;
+        }
+        else if (arg == "--jobs" && i + 1 < argc)
+        {
+            jobs = stoul(argv[++i]);
+        }
+        else if (arg == "--out" && i + 1 < argc)
+        {
+            output_dir = argv[++i];
+        }
+        else if (arg == "--no-listing")
+        {
+            tables = false;
+        }
+        else if (arg == "--objects")
+        {
+            objects = true;
+        }
+        else if (arg == "--stats=json")
+        {
+            stats_json = true;
+        }
+        else if (fs::is_directory(arg))
+        {
+            vector<string> found;
+            for (const auto &entry : fs::directory_iterator(arg))
+            {
+                if (entry.is_regular_file() && entry.path().extension() == ".txt")
+                {
+                    found.push_back(entry.path().string());
+                }
+            }
+            sort(found.begin(), found.end());
+            sources.insert(sources.end(), found.begin(), found.end());
+        }
+        else
+        {
+            sources.push_back(arg);
+        }
+    }
+
+    if (sources.empty())
+    {
+        cerr << "Usage: batch_assembler [--single-pass] [--jobs N] [--out DIR] [--no-listing] [--objects] [--stats=json] source|directory..." << endl;
+        return 1;
+    }
+
+    if (stats_json && !STATS_ENABLED)
+    {
+        cerr << "Error: --stats needs a build with -DASSEMBLER_STATS!" << endl;
+        return 1;
+    }
+
+    fs::create_directories(output_dir);
+
+    // Sources with the same name in different directories get numbered outputs
+    vector<BatchResult> results(sources.size());
+    unordered_set<string> used_names;
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        string name = fs::path(sources[i]).stem().string();
+        if (!used_names.insert(name).second)
+        {
+            name += "_" + to_string(i);
+            used_names.insert(name);
+        }
+
+        results[i].source = sources[i];
+        results[i].output = (output_dir / (name + ".lst")).string();
+        if (objects)
+        {
+            results[i].object = (output_dir / (name + ".obj")).string();
+        }
+    }
+
+    auto begin = chrono::steady_clock::now();
+    {
+        ThreadPool pool(jobs);
+        for (auto &result : results)
+        {
+            pool.submit([&result, options, tables]
+                        { assembleFile(result, options, tables); });
+        }
+        pool.wait();
+        jobs = pool.size();
+    }
+    auto finish = chrono::steady_clock::now();
+
+    size_t total_lines = 0;
+    size_t failed = 0;
+    for (const auto &result : results)
+    {
+        total_lines += result.lines;
+        if (!result.ok)
+        {
+            cerr << "Error: Could not assemble " << result.source << "!" << endl;
+            failed++;
+        }
+    }
+
+    double seconds = chrono::duration<double>(finish - begin).count();
+    cout << "Assembled " << results.size() - failed << " of " << results.size() << " files ("
+         << total_lines << " lines) on " << jobs << " threads in "
+         << fixed << setprecision(3) << seconds * 1000 << " ms" << endl;
+    cout << setprecision(0) << results.size() / seconds << " files/sec, "
+         << total_lines / seconds << " lines/sec" << endl;
+
+    if (stats_json)
+    {
+        OutputWriter err(2);
+        writeStatsJson(err);
+    }
+
+    return failed == 0 ? 0 : 1;
+}
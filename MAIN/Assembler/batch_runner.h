@@ -0,0 +1,117 @@
+#pragma once
+
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "simulator.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// How one instance of a batch ended
+struct InstanceResult
+{
+    SimResult result;
+    MachineState state; // registers, condition and pc after the run
+};
+
+// Runs many instances of one program on the work-stealing thread pool. Every
+// instance starts from a copy of one initial state, so they share the
+// decoded program (Simulator::run() is const) and the data segment, which an
+// instance only copies when its setup writes inputs to it.
+//
+// Instances go to the pool in chunks. Results come back to the thread that
+// called run(), in instance order, while later chunks are still running;
+// at most a few chunks per worker are in flight, so a batch of millions of
+// instances streams through a fixed amount of memory.
+class BatchRunner
+{
+public:
+    // Writes the inputs of an instance into its state; called on the workers
+    using Setup = function<void(size_t index, MachineState &state)>;
+    // Takes the result of an instance; called on the thread of run()
+    using Report = function<void(size_t index, const InstanceResult &instance)>;
+
+private:
+    struct Chunk
+    {
+        vector<InstanceResult> results;
+        bool done = false;
+    };
+
+    const Simulator &simulator;
+    ThreadPool pool;
+    size_t chunk_size;
+
+    mutex done_lock;
+    condition_variable done;
+
+    void runChunk(Chunk &chunk, size_t first, size_t last, const MachineState &initial, const Setup &setup,
+                  uint64_t max_steps)
+    {
+        chunk.results.resize(last - first);
+        for (size_t i = first; i < last; i++)
+        {
+            InstanceResult &instance = chunk.results[i - first];
+            instance.state = initial;
+            if (setup)
+            {
+                setup(i, instance.state);
+            }
+            instance.result = simulator.run(instance.state, max_steps);
+        }
+
+        lock_guard<mutex> guard(done_lock);
+        chunk.done = true;
+        done.notify_all();
+    }
+
+public:
+    explicit BatchRunner(const Simulator &simulator, size_t jobs = thread::hardware_concurrency(),
+                         size_t chunk_size = 64)
+        : simulator(simulator), pool(jobs), chunk_size(max<size_t>(chunk_size, 1))
+    {
+    }
+
+    size_t threads() const { return pool.size(); }
+
+    // Runs instances 0 to count - 1 from initial for at most max_steps
+    // instructions each and reports them in order
+    void run(size_t count, const MachineState &initial, const Setup &setup, const Report &report,
+             uint64_t max_steps = UINT64_MAX)
+    {
+        size_t chunks = count / chunk_size + (count % chunk_size != 0);
+        size_t window = pool.size() * 4;
+        deque<Chunk> in_flight; // from chunk `reported` on; push_back and pop_front keep references
+        size_t submitted = 0;
+
+        for (size_t reported = 0; reported < chunks; reported++)
+        {
+            while (submitted < chunks && submitted - reported < window)
+            {
+                in_flight.emplace_back();
+                Chunk &chunk = in_flight.back();
+                size_t first = submitted * chunk_size;
+                size_t last = min(first + chunk_size, count);
+                pool.submit([this, &chunk, first, last, &initial, &setup, max_steps]
+                            { runChunk(chunk, first, last, initial, setup, max_steps); });
+                submitted++;
+            }
+
+            Chunk &chunk = in_flight.front();
+            {
+                unique_lock<mutex> guard(done_lock);
+                done.wait(guard, [&]
+                          { return chunk.done; });
+            }
+            for (size_t i = 0; i < chunk.results.size(); i++)
+            {
+                report(reported * chunk_size + i, chunk.results[i]);
+            }
+            in_flight.pop_front();
+        }
+    }
+};
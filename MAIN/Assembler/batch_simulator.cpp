@@ -0,0 +1,370 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <chrono>
+#include <charconv>
+#include "assembler.h"
+#include "source_reader.h"
+#include "output_writer.h"
+#include "simulator.h"
+#include "batch_runner.h"
+
+using namespace std;
+
+// A memory word an instance writes: NAME or NAME+K for a word of an array
+struct MemoryInput
+{
+    string name;
+    int address = 0;
+};
+
+// --sweep: every value from first to last, one instance each
+struct Sweep
+{
+    MemoryInput input;
+    int64_t first = 0;
+    int64_t last = 0;
+
+    // 0 for the whole int64 range, which has one value too many to count
+    uint64_t size() const { return (uint64_t)last - (uint64_t)first + 1; }
+};
+
+// Parses a whole decimal number, false if text is anything else or out of range
+bool parseValue(const string &text, int64_t &value)
+{
+    const char *end = text.data() + text.size();
+    auto [stop, error] = from_chars(text.data(), end, value);
+    return !text.empty() && error == errc() && stop == end;
+}
+
+// Address of NAME or NAME+K, -1 if it is not a word of the loaded program
+int inputAddress(const SymbolTable &symbols, const Simulator &simulator, const string &name)
+{
+    size_t plus = name.find('+');
+    int symbol = symbols.find(name.substr(0, plus));
+    int64_t offset = 0;
+    if (symbol == 0 || (plus != string::npos && !parseValue(name.substr(plus + 1), offset)))
+    {
+        return -1;
+    }
+    int64_t address = symbols[symbol - 1].second + max<int64_t>(min<int64_t>(offset, INT_MAX), INT_MIN);
+    return address >= INT_MIN && address <= INT_MAX && simulator.programImage().contains((int)address) ? (int)address : -1;
+}
+
+// Splits NAME=VALUE, false without the =
+bool splitSetting(const string &setting, string &name, string &value)
+{
+    size_t equals = setting.find('=');
+    if (equals == string::npos)
+    {
+        return false;
+    }
+    name = setting.substr(0, equals);
+    value = setting.substr(equals + 1);
+    return true;
+}
+
+// Usage: batch_simulator [--optimize] [--thread-jumps] [--remove-dead] [--no-fuse] [--jobs N]
+//                        [--chunk N] [--max-steps N] [--set NAME=VALUE]... [--sweep NAME=FIRST:LAST]...
+//                        [--inputs FILE] [--summary] file
+// Runs many instances of one assembled program (a source, or an object file
+// written with --object) on a thread pool, each with its own inputs in memory
+// (see batch_runner.h). --set writes a word of every instance; --inputs gives
+// one instance per non-empty line of FILE, each line a list of NAME=VALUE;
+// every --sweep multiplies the instances by the values of its range, the last
+// sweep changing fastest, and is written after the line. NAME+K is the word K
+// after NAME. For instance
+//     batch_simulator --sweep TARGET=0:999 --sweep LENGTH=1:100 ../project2_1.txt
+// searches 1000 targets in 100 array lengths.
+//
+// Results stream to stdout in instance order as tab-separated lines of
+// index, status, pc, instructions and AREG..DREG, then a summary of the
+// statuses, instructions and throughput; --summary prints only that.
+int main(int argc, char *argv[])
+{
+    string filename;
+    string inputs_file;
+    AssemblerOptions options;
+    bool fuse = true;
+    bool summary_only = false;
+    size_t jobs = thread::hardware_concurrency();
+    size_t chunk_size = 64;
+    uint64_t max_steps = UINT64_MAX;
+    vector<string> settings;
+    vector<string> sweep_settings;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--optimize")
+        {
+            options.optimize = true;
+        }
+        else if (arg == "--thread-jumps")
+        {
+            options.thread_jumps = true;
+        }
+        else if (arg == "--remove-dead")
+        {
+            options.remove_dead = true;
+        }
+        else if (arg == "--no-fuse")
+        {
+            fuse = false;
+        }
+        else if (arg == "--summary")
+        {
+            summary_only = true;
+        }
+        else if (arg == "--jobs" && i + 1 < argc)
+        {
+            jobs = stoul(argv[++i]);
+        }
+        else if (arg == "--chunk" && i + 1 < argc)
+        {
+            chunk_size = stoul(argv[++i]);
+        }
+        else if (arg == "--max-steps" && i + 1 < argc)
+        {
+            max_steps = stoull(argv[++i]);
+        }
+        else if (arg == "--set" && i + 1 < argc)
+        {
+            settings.push_back(argv[++i]);
+        }
+        else if (arg == "--sweep" && i + 1 < argc)
+        {
+            sweep_settings.push_back(argv[++i]);
+        }
+        else if (arg == "--inputs" && i + 1 < argc)
+        {
+            inputs_file = argv[++i];
+        }
+        else
+        {
+            filename = arg;
+        }
+    }
+
+    if (filename.empty())
+    {
+        cerr << "Usage: batch_simulator [--optimize] [--thread-jumps] [--remove-dead] [--no-fuse] [--jobs N]" << endl
+             << "                       [--chunk N] [--max-steps N] [--set NAME=VALUE]... [--sweep NAME=FIRST:LAST]..." << endl
+             << "                       [--inputs FILE] [--summary] file" << endl;
+        return 1;
+    }
+
+    LoadedProgram program;
+    if (!loadProgram(filename, options, program))
+    {
+        return 1;
+    }
+    Simulator simulator(move(program.image), fuse);
+
+    // Resolves NAME=VALUE, or reports it and returns false
+    auto resolve = [&](const string &setting, MemoryInput &input, string &value)
+    {
+        if (!splitSetting(setting, input.name, value))
+        {
+            cerr << "Error: " << setting << " is not NAME=VALUE!" << endl;
+            return false;
+        }
+        input.address = inputAddress(program.symbols, simulator, input.name);
+        if (input.address == -1)
+        {
+            cerr << "Error: " << input.name << " is not a word of the program's memory!" << endl;
+            return false;
+        }
+        return true;
+    };
+
+    // Resolves NAME=VALUE with a number for VALUE
+    auto resolveValue = [&](const string &setting, MemoryInput &input, int64_t &value)
+    {
+        string text;
+        if (!resolve(setting, input, text))
+        {
+            return false;
+        }
+        if (!parseValue(text, value))
+        {
+            cerr << "Error: " << setting << " is not NAME=VALUE!" << endl;
+            return false;
+        }
+        return true;
+    };
+
+    MachineState initial = simulator.initialState();
+    for (const string &setting : settings)
+    {
+        MemoryInput input;
+        int64_t value;
+        if (!resolveValue(setting, input, value))
+        {
+            return 1;
+        }
+        simulator.write(initial, input.address, value);
+    }
+
+    uint64_t count = 1;
+    vector<Sweep> sweeps;
+    for (const string &setting : sweep_settings)
+    {
+        Sweep sweep;
+        string range;
+        if (!resolve(setting, sweep.input, range))
+        {
+            return 1;
+        }
+        size_t colon = range.find(':');
+        if (!parseValue(range.substr(0, colon), sweep.first) ||
+            !parseValue(colon == string::npos ? range : range.substr(colon + 1), sweep.last))
+        {
+            cerr << "Error: " << setting << " is not NAME=FIRST:LAST!" << endl;
+            return 1;
+        }
+        if (sweep.last < sweep.first)
+        {
+            cerr << "Error: " << setting << " is an empty range!" << endl;
+            return 1;
+        }
+        if (sweep.size() == 0 || count > UINT64_MAX / sweep.size())
+        {
+            cerr << "Error: " << setting << " makes too many instances!" << endl;
+            return 1;
+        }
+        count *= sweep.size();
+        sweeps.push_back(sweep);
+    }
+
+    // One list of (address, value) per line of the inputs file
+    vector<vector<pair<int, int64_t>>> lines;
+    if (!inputs_file.empty())
+    {
+        SourceReader reader;
+        if (!reader.open(inputs_file))
+        {
+            cerr << "Error: Could not open " << inputs_file << "!" << endl;
+            return 1;
+        }
+        string_view text = reader.text();
+        while (!text.empty())
+        {
+            size_t end = text.find('\n');
+            string_view line = text.substr(0, end);
+            text.remove_prefix(end == string_view::npos ? text.size() : end + 1);
+
+            vector<pair<int, int64_t>> words;
+            while (!line.empty())
+            {
+                size_t space = line.find_first_of(" \t\r");
+                string setting(line.substr(0, space));
+                line.remove_prefix(space == string_view::npos ? line.size() : space + 1);
+                if (setting.empty())
+                {
+                    continue;
+                }
+                MemoryInput input;
+                int64_t value;
+                if (!resolveValue(setting, input, value))
+                {
+                    return 1;
+                }
+                words.push_back({input.address, value});
+            }
+            if (!words.empty())
+            {
+                lines.push_back(move(words));
+            }
+        }
+        if (!lines.empty() && count > UINT64_MAX / lines.size())
+        {
+            cerr << "Error: " << inputs_file << " and the sweeps make too many instances!" << endl;
+            return 1;
+        }
+        count *= lines.size();
+    }
+
+    // Instance index = line * (product of the sweep sizes) + sweep digits;
+    // the sweeps are written after the line, so they win over it
+    uint64_t sweep_count = count / max<size_t>(lines.size(), 1);
+    auto setup = [&](size_t index, MachineState &state)
+    {
+        if (!lines.empty())
+        {
+            for (const auto &word : lines[index / sweep_count])
+            {
+                simulator.write(state, word.first, word.second);
+            }
+        }
+        for (size_t s = sweeps.size(); s-- > 0;)
+        {
+            simulator.write(state, sweeps[s].input.address, (int64_t)((uint64_t)sweeps[s].first + index % sweeps[s].size()));
+            index /= sweeps[s].size();
+        }
+    };
+
+    OutputWriter out(1);
+    uint64_t status_counts[(int)SimStatus::STEP_LIMIT + 1] = {};
+    uint64_t total_steps = 0;
+    uint64_t min_steps = UINT64_MAX, max_run = 0;
+    auto report = [&](size_t index, const InstanceResult &instance)
+    {
+        status_counts[(int)instance.result.status]++;
+        total_steps += instance.result.steps;
+        min_steps = min(min_steps, instance.result.steps);
+        max_run = max(max_run, instance.result.steps);
+        if (summary_only)
+        {
+            return;
+        }
+        out.writeInt(index);
+        out.write("\t");
+        out.write(simStatusName(instance.result.status));
+        out.write("\t");
+        out.writeInt(instance.state.pc);
+        out.write("\t");
+        out.writeInt(instance.result.steps);
+        for (int r = 1; r <= 4; r++)
+        {
+            out.write("\t");
+            out.writeInt(instance.state.registers[r]);
+        }
+        out.write("\n");
+    };
+
+    BatchRunner runner(simulator, jobs, chunk_size);
+    if (!summary_only)
+    {
+        out.write("Instance\tStatus\tPC\tInstructions\tAREG\tBREG\tCREG\tDREG\n");
+    }
+    auto begin = chrono::steady_clock::now();
+    runner.run(count, initial, setup, report, max_steps);
+    auto finish = chrono::steady_clock::now();
+    if (!out.flush())
+    {
+        cerr << "Error: Could not write the results!" << endl;
+        return 1;
+    }
+
+    double seconds = chrono::duration<double>(finish - begin).count();
+    if (!summary_only)
+    {
+        cout << endl;
+    }
+    cout << "Instances:     " << count << " on " << runner.threads() << " threads" << endl;
+    for (int status = 0; status <= (int)SimStatus::STEP_LIMIT; status++)
+    {
+        if (status_counts[status] > 0)
+        {
+            cout << "  " << left << setw(26) << simStatusName((SimStatus)status) << status_counts[status] << endl;
+        }
+    }
+    cout << "Instructions:  " << total_steps << " (" << (count == 0 ? 0 : min_steps) << " to " << max_run
+         << " per instance)" << endl;
+    cout << "Time (ms):     " << fixed << setprecision(2) << seconds * 1000 << endl;
+    cout << "Instances/sec: " << setprecision(0) << count / max(seconds, 1e-9) << endl;
+    cout << "Instr/sec:     " << total_steps / max(seconds, 1e-9) << endl;
+    return 0;
+}
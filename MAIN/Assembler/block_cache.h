@@ -0,0 +1,464 @@
+#pragma once
+
+#include <unordered_map>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "simulator.h"
+
+using namespace std;
+
+// Basic-block translation cache over the simulator. The first time execution
+// reaches an address, the instructions from there up to the next jump or
+// STOP (or END, EXTERN and the ones that cannot run) are translated into a
+// block: a sequence of ops with their handler, register and operand bound in,
+// ending with the op that leaves the block. A block runs straight through with
+// one step check for all of it, and its exit keeps the blocks it goes to once
+// it has looked them up, so a hot loop goes from block to block without a
+// lookup. The handler is the address of its code (computed goto) on GCC and
+// Clang, and the SimOp of a switch elsewhere.
+//
+// Blocks take the superinstructions of the simulator: a fused pair is one op
+// of the block, and one with JZ/JNZ leaves it. The step check of the block
+// covers both instructions of a pair, so a block never has to split one.
+//
+// No instruction writes memory, so the only way to change the code is
+// patch(). It invalidates every block whose addresses the patch touches
+// (including the declarations skipped before the block's first instruction)
+// and forgets every cached exit, which are looked up again on their next use.
+//
+// Unlike Simulator::run(), run() translates as it goes, so a BlockCache
+// belongs to one thread.
+class BlockCache
+{
+private:
+    struct BlockOp
+    {
+        const void *handler; // bound by run() under SIMULATOR_COMPUTED_GOTO
+        SimOp op;
+        uint8_t reg;
+        int32_t operand; // memory index or register code
+        int32_t second;  // memory index of the ADD/SUB of MOVER_ADD/MOVER_SUB
+        int32_t lc;
+    };
+
+    struct Block;
+
+    // A cached successor, with what entering it needs copied in, so a jump
+    // to it loads only from the block it leaves. size is UINT64_MAX until
+    // the successor is looked up, which fails the step check.
+    struct Exit
+    {
+        Block *block = nullptr;
+        const BlockOp *ops = nullptr;
+        uint64_t size = UINT64_MAX;
+    };
+
+    struct Block
+    {
+        int entry = 0;         // address it was entered at
+        int end = 0;           // first address after its last instruction
+        vector<BlockOp> ops;   // the last one leaves the block
+        uint64_t size = 0;     // instructions, two for a superinstruction
+        int taken_address = 0; // a jump's target as written, -1 for EXTERN
+        Exit next[2];          // cached blocks after the exit and at taken_address
+    };
+
+    Simulator simulator;
+    bool fuse;
+    unordered_map<int, unique_ptr<Block>> blocks; // by entry address
+    Block extern_block;                            // where a jump to EXTERN goes
+    size_t translations = 0;
+
+    static bool isFused(SimOp op) { return op >= SimOp::COMP_M_JZ; }
+
+    // Whether an op leaves the straight line: the jumps of the MOT and the
+    // superinstructions that end in one, STOP, and the ops that end a run
+    static bool endsBlock(SimOp op)
+    {
+        return (op >= SimOp::JMP && op <= SimOp::BAD_ADDRESS) || (op >= SimOp::COMP_M_JZ && op <= SimOp::DECR_JNZ);
+    }
+
+    Block *translate(int address, const void *const *handlers)
+    {
+        auto block = make_unique<Block>();
+        block->entry = address;
+
+        const ProgramImage &image = simulator.programImage();
+        int last_lc = 0; // of the last instruction, the second of a pair
+        SimOp last = SimOp::END;
+        for (uint32_t index = simulator.instructionFrom(address);; index++)
+        {
+            const SimInstruction &instruction = simulator.instruction(index);
+            SimOp op = instruction.op;
+            const void *handler = handlers != nullptr ? handlers[(int)op] : nullptr;
+            block->ops.push_back({handler, op, instruction.reg, instruction.operand, (int32_t)instruction.target,
+                                  instruction.lc});
+            block->size++;
+            last_lc = instruction.lc;
+            last = op;
+            if (isFused(op))
+            {
+                index++;
+                block->size++;
+                last_lc = simulator.instruction(index).lc;
+                last = simulator.instruction(index).op;
+            }
+            if (endsBlock(op))
+            {
+                break;
+            }
+        }
+
+        block->end = last == SimOp::END ? image.base + (int)image.size() : last_lc + 2;
+        if (last == SimOp::JMP || last == SimOp::JZ || last == SimOp::JNZ)
+        {
+            // The address as written, not the instruction it resolved to: a
+            // patch in between has to invalidate the target's block
+            block->taken_address = decodeInstruction(image.code[last_lc - image.base]).operand;
+        }
+
+        translations++;
+        Block *result = block.get();
+        blocks[address] = move(block);
+        return result;
+    }
+
+    Block *blockAt(int address, const void *const *handlers)
+    {
+        if (address == -1)
+        {
+            if (extern_block.ops.empty())
+            {
+                const void *handler = handlers != nullptr ? handlers[(int)SimOp::EXTERN] : nullptr;
+                extern_block.ops.push_back({handler, SimOp::EXTERN, 0, 0, 0, -1});
+                extern_block.size = 1;
+            }
+            return &extern_block;
+        }
+        auto found = blocks.find(address);
+        return found != blocks.end() ? found->second.get() : translate(address, handlers);
+    }
+
+    // Drops the blocks that overlap [low, high) and every cached exit
+    void invalidate(int low, int high)
+    {
+        for (auto it = blocks.begin(); it != blocks.end();)
+        {
+            const Block &block = *it->second;
+            it = block.entry < high && low < block.end ? blocks.erase(it) : next(it);
+        }
+        for (auto &entry : blocks)
+        {
+            entry.second->next[0] = entry.second->next[1] = Exit();
+        }
+    }
+
+public:
+    // fuse = false runs the instructions of every pair as two ops
+    explicit BlockCache(ProgramImage image, bool fuse = true) : simulator(move(image), fuse), fuse(fuse)
+    {
+        extern_block.entry = extern_block.end = -1;
+    }
+
+    const Simulator &decoded() const { return simulator; }
+    size_t blockCount() const { return blocks.size(); }
+    size_t translationCount() const { return translations; }
+
+    MachineState initialState() const { return simulator.initialState(); }
+    bool write(MachineState &state, int address, int64_t value) const { return simulator.write(state, address, value); }
+
+    // Replaces the code at address with an instruction, laid out the way
+    // loadImage() lays one out (opcode 0 only clears the word). States made
+    // before keep their memory. Decoding starts over, so this is for rare
+    // changes, not for every step. False if the words are outside the image.
+    bool patch(int address, const InstructionWord &word)
+    {
+        ProgramImage image = simulator.programImage();
+        if (!image.contains(address) || (word.opcode != 0 && !image.contains(address + 1)))
+        {
+            return false;
+        }
+        size_t at = address - image.base;
+        image.code[at] = word.opcode != 0 ? encodeInstruction(word) : 0;
+        if (word.opcode != 0)
+        {
+            image.code[at + 1] = 0;
+            image.data[at] = image.data[at + 1] = 0;
+            if (at > 0)
+            {
+                image.code[at - 1] = 0;
+            }
+        }
+        image.entry = -1;
+        for (size_t i = 0; i < image.size() && image.entry == -1; i++)
+        {
+            if (image.code[i] != 0)
+            {
+                image.entry = image.base + i;
+            }
+        }
+
+        simulator = Simulator(move(image), fuse);
+        invalidate(address - 1, address + 2);
+        return true;
+    }
+
+    // Runs from state.pc like Simulator::run(), a block at a time
+    SimResult run(MachineState &state, uint64_t max_steps = UINT64_MAX)
+    {
+        const int64_t *memory = state.memory.data();
+        int64_t r[5] = {state.registers[0], state.registers[1], state.registers[2], state.registers[3], state.registers[4]};
+        bool zero = state.zero;
+        uint64_t left = max_steps;
+        uint64_t fused = 0;
+        SimStatus status;
+        Block *block;
+        const BlockOp *op;
+        bool taken = false;
+
+#ifdef SIMULATOR_COMPUTED_GOTO
+        // In SimOp order
+        static const void *const handlers[] = {
+            &&op_MOVER_M, &&op_MOVER_R, &&op_ADD_M, &&op_ADD_R, &&op_SUB_M, &&op_SUB_R, &&op_MULT_M, &&op_MULT_R,
+            &&op_DIV_M, &&op_DIV_R, &&op_COMP_M, &&op_COMP_R, &&op_INCR, &&op_DECR, &&op_JMP, &&op_JZ, &&op_JNZ,
+            &&op_STOP, &&op_END, &&op_EXTERN, &&op_ILLEGAL, &&op_BAD_ADDRESS,
+            &&op_COMP_M_JZ, &&op_COMP_M_JNZ, &&op_COMP_R_JZ, &&op_COMP_R_JNZ, &&op_INCR_JZ, &&op_INCR_JNZ,
+            &&op_DECR_JZ, &&op_DECR_JNZ, &&op_MOVER_ADD, &&op_MOVER_SUB};
+        static_assert(size(handlers) == (size_t)SimOp::COUNT, "one handler per SimOp");
+#define DISPATCH() goto *op->handler
+#define HANDLER(name) op_##name:
+#else
+        const void *const *handlers = nullptr;
+#define DISPATCH() goto dispatch
+#define HANDLER(name) case SimOp::name:
+#endif
+
+        // A jump goes straight on into a cached block with enough steps left
+        // for all of it; anything else takes the way through follow and enter.
+        // Each way is its own branch, so the jump is predicted instead of
+        // waiting for the condition to pick the exit to load.
+#define FOLLOW_TO(way)                       \
+    do                                       \
+    {                                        \
+        taken = (way);                       \
+        const Exit &exit = block->next[way]; \
+        if (left <= exit.size)               \
+        {                                    \
+            goto follow;                     \
+        }                                    \
+        left -= exit.size;                   \
+        op = exit.ops;                       \
+        block = exit.block;                  \
+        DISPATCH();                          \
+    } while (0)
+#define FOLLOW(way)      \
+    if (way)             \
+    {                    \
+        FOLLOW_TO(true); \
+    }                    \
+    FOLLOW_TO(false)
+
+        block = blockAt(state.pc, handlers);
+    enter:
+        if (left <= block->size)
+        {
+            // Too few steps left for the whole block: the simulator runs the
+            // rest one instruction at a time
+            for (int i = 0; i < 5; i++)
+            {
+                state.registers[i] = r[i];
+            }
+            state.zero = zero;
+            state.pc = block->entry;
+            SimResult rest = simulator.run(state, left);
+            return {rest.status, max_steps - left + rest.steps, fused + rest.fused};
+        }
+        op = block->ops.data();
+        left -= block->size;
+#ifdef SIMULATOR_COMPUTED_GOTO
+        DISPATCH();
+#else
+    dispatch:
+        switch (op->op)
+        {
+#endif
+        HANDLER(MOVER_M)
+        r[op->reg] = memory[op->operand];
+        op++;
+        DISPATCH();
+        HANDLER(MOVER_R)
+        r[op->reg] = r[op->operand];
+        op++;
+        DISPATCH();
+        HANDLER(ADD_M)
+        r[op->reg] = (int64_t)((uint64_t)r[op->reg] + (uint64_t)memory[op->operand]);
+        op++;
+        DISPATCH();
+        HANDLER(ADD_R)
+        r[op->reg] = (int64_t)((uint64_t)r[op->reg] + (uint64_t)r[op->operand]);
+        op++;
+        DISPATCH();
+        HANDLER(SUB_M)
+        r[op->reg] = (int64_t)((uint64_t)r[op->reg] - (uint64_t)memory[op->operand]);
+        op++;
+        DISPATCH();
+        HANDLER(SUB_R)
+        r[op->reg] = (int64_t)((uint64_t)r[op->reg] - (uint64_t)r[op->operand]);
+        op++;
+        DISPATCH();
+        HANDLER(MULT_M)
+        r[op->reg] = (int64_t)((uint64_t)r[op->reg] * (uint64_t)memory[op->operand]);
+        op++;
+        DISPATCH();
+        HANDLER(MULT_R)
+        r[op->reg] = (int64_t)((uint64_t)r[op->reg] * (uint64_t)r[op->operand]);
+        op++;
+        DISPATCH();
+        HANDLER(DIV_M)
+        {
+            int64_t divisor = memory[op->operand];
+            if (divisor == 0)
+            {
+                goto divide_by_zero;
+            }
+            r[op->reg] = divisor == -1 ? (int64_t)(0 - (uint64_t)r[op->reg]) : r[op->reg] / divisor;
+        }
+        op++;
+        DISPATCH();
+        HANDLER(DIV_R)
+        {
+            int64_t divisor = r[op->operand];
+            if (divisor == 0)
+            {
+                goto divide_by_zero;
+            }
+            r[op->reg] = divisor == -1 ? (int64_t)(0 - (uint64_t)r[op->reg]) : r[op->reg] / divisor;
+        }
+        op++;
+        DISPATCH();
+        HANDLER(COMP_M)
+        zero = r[op->reg] == memory[op->operand];
+        op++;
+        DISPATCH();
+        HANDLER(COMP_R)
+        zero = r[op->reg] == r[op->operand];
+        op++;
+        DISPATCH();
+        HANDLER(INCR)
+        r[op->reg] = (int64_t)((uint64_t)r[op->reg] + 1);
+        op++;
+        DISPATCH();
+        HANDLER(DECR)
+        r[op->reg] = (int64_t)((uint64_t)r[op->reg] - 1);
+        op++;
+        DISPATCH();
+        HANDLER(JMP)
+        FOLLOW_TO(true);
+        HANDLER(JZ)
+        FOLLOW(zero);
+        HANDLER(JNZ)
+        FOLLOW(!zero);
+        HANDLER(COMP_M_JZ)
+        fused++;
+        zero = r[op->reg] == memory[op->operand];
+        FOLLOW(zero);
+        HANDLER(COMP_M_JNZ)
+        fused++;
+        zero = r[op->reg] == memory[op->operand];
+        FOLLOW(!zero);
+        HANDLER(COMP_R_JZ)
+        fused++;
+        zero = r[op->reg] == r[op->operand];
+        FOLLOW(zero);
+        HANDLER(COMP_R_JNZ)
+        fused++;
+        zero = r[op->reg] == r[op->operand];
+        FOLLOW(!zero);
+        HANDLER(INCR_JZ)
+        fused++;
+        r[op->reg] = (int64_t)((uint64_t)r[op->reg] + 1);
+        FOLLOW(zero);
+        HANDLER(INCR_JNZ)
+        fused++;
+        r[op->reg] = (int64_t)((uint64_t)r[op->reg] + 1);
+        FOLLOW(!zero);
+        HANDLER(DECR_JZ)
+        fused++;
+        r[op->reg] = (int64_t)((uint64_t)r[op->reg] - 1);
+        FOLLOW(zero);
+        HANDLER(DECR_JNZ)
+        fused++;
+        r[op->reg] = (int64_t)((uint64_t)r[op->reg] - 1);
+        FOLLOW(!zero);
+        HANDLER(MOVER_ADD)
+        fused++;
+        r[op->reg] = (int64_t)((uint64_t)memory[op->operand] + (uint64_t)memory[op->second]);
+        op++;
+        DISPATCH();
+        HANDLER(MOVER_SUB)
+        fused++;
+        r[op->reg] = (int64_t)((uint64_t)memory[op->operand] - (uint64_t)memory[op->second]);
+        op++;
+        DISPATCH();
+        HANDLER(STOP)
+        status = SimStatus::STOPPED;
+        goto done;
+        // The rest are not instructions and do not count as steps
+        HANDLER(END)
+        left++;
+        status = SimStatus::END_OF_CODE;
+        goto done;
+        HANDLER(EXTERN)
+        left++;
+        status = SimStatus::EXTERN_JUMP;
+        goto done;
+        HANDLER(BAD_ADDRESS)
+        left++;
+        status = SimStatus::BAD_ADDRESS;
+        goto done;
+#ifndef SIMULATOR_COMPUTED_GOTO
+        default:
+#endif
+        HANDLER(ILLEGAL)
+        left++;
+        status = SimStatus::ILLEGAL_INSTRUCTION;
+        goto done;
+#ifndef SIMULATOR_COMPUTED_GOTO
+        }
+#endif
+#undef FOLLOW
+#undef FOLLOW_TO
+#undef DISPATCH
+#undef HANDLER
+
+    follow:
+    {
+        // Look the next block up once, then keep it
+        Exit &exit = block->next[taken];
+        if (exit.block == nullptr)
+        {
+            exit.block = blockAt(taken ? block->taken_address : block->end, handlers);
+            exit.ops = exit.block->ops.data();
+            exit.size = exit.block->size;
+        }
+        block = exit.block;
+        goto enter;
+    }
+    divide_by_zero:
+        // DIV and the ops after it did not run
+        for (const BlockOp *rest = op; rest != block->ops.data() + block->ops.size(); rest++)
+        {
+            left += isFused(rest->op) ? 2 : 1;
+        }
+        status = SimStatus::DIVIDE_BY_ZERO;
+    done:
+        for (int i = 0; i < 5; i++)
+        {
+            state.registers[i] = r[i];
+        }
+        state.zero = zero;
+        state.pc = op->lc;
+        return {status, max_steps - left, fused};
+    }
+};
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstdlib>
+#include "assembler.h"
+#include "simulator.h"
+
+using namespace std;
+
+// Ahead-of-time backend: translates an assembled program into one C
+// translation unit that the system C compiler builds into a native
+// executable or a shared object.
+//
+// The translation follows the decoded instructions of the simulator, so it
+// has the same machine model and the same results, step limits included.
+// Every instruction gets a label named after its address, AREG..DREG are
+// locals of aot_run() and jumps are gotos. The unit exports:
+//
+//   const int aot_base, aot_size, aot_entry;   image bounds and first instruction
+//   const int64_t aot_data[];                  loaded memory, aot_size words
+//   const aot_symbol aot_symbols[];            symbol names and addresses
+//   const int aot_symbol_count;
+//   int aot_run(aot_state *, uint64_t max_steps, uint64_t *steps);
+//
+// aot_run() works like Simulator::run(): it starts at state->pc, writes the
+// registers, condition and pc back and returns a SimStatus value. Built with
+// -DAOT_MAIN the unit also has a main() that runs the program from its entry
+// and prints what the simulator driver prints.
+
+// aot_state of the generated code
+struct AotState
+{
+    int64_t registers[5];
+    int32_t zero;
+    int32_t pc;
+    const int64_t *memory; // int64_t * in C; the generated code only reads it
+};
+
+using AotRun = int (*)(AotState *, uint64_t, uint64_t *);
+
+inline string cStringLiteral(string_view text)
+{
+    string literal = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            literal += '\\';
+        }
+        if ((unsigned char)c < 32)
+        {
+            c = '?';
+        }
+        literal += c;
+    }
+    return literal + "\"";
+}
+
+// Returns the C translation of a loaded program with its symbols; name goes
+// into the header comment
+inline string translateToC(const ProgramImage &image, const SymbolTable &symbols, string_view name)
+{
+    static const char *const REGISTER_NAMES[] = {"R0", "AREG", "BREG", "CREG", "DREG"};
+
+    Simulator simulator(image, false);
+    const uint32_t count = simulator.instructionCount();
+    const int end = image.base + (int)image.size();
+
+    string c;
+    c.reserve(4096 + count * 96 + image.size() * 24);
+    c += "/* C translation of " + string(name) + ", written by the aot backend */\n";
+    c += "#define _POSIX_C_SOURCE 199309L\n"
+         "#include <stdint.h>\n"
+         "#include <inttypes.h>\n"
+         "#include <stdio.h>\n"
+         "#include <stdlib.h>\n"
+         "#include <string.h>\n"
+         "#include <time.h>\n\n";
+
+    // In SimStatus order
+    c += "enum { AOT_STOPPED, AOT_END_OF_CODE, AOT_EXTERN_JUMP, AOT_ILLEGAL_INSTRUCTION,\n"
+         "       AOT_BAD_ADDRESS, AOT_DIVIDE_BY_ZERO, AOT_STEP_LIMIT };\n\n";
+    c += "typedef struct\n{\n    int64_t registers[5];\n    int32_t zero;\n    int32_t pc;\n    int64_t *memory;\n} aot_state;\n\n";
+    c += "typedef struct\n{\n    const char *name;\n    int address;\n} aot_symbol;\n\n";
+
+    c += "const int aot_base = " + to_string(image.base) + ";\n";
+    c += "const int aot_size = " + to_string(image.size()) + ";\n";
+    c += "const int aot_entry = " + to_string(image.entry) + ";\n";
+    c += "const int64_t aot_data[] = {";
+    for (size_t i = 0; i < image.size(); i++)
+    {
+        c += (i % 8 == 0 ? "\n    " : " ") + to_string(image.data[i]) + "LL,";
+    }
+    c += image.size() == 0 ? "0};\n" : "\n};\n";
+
+    c += "const aot_symbol aot_symbols[] = {";
+    for (const auto &entry : symbols)
+    {
+        c += "\n    {" + cStringLiteral(entry.first) + ", " + to_string(entry.second) + "},";
+    }
+    c += symbols.size() == 0 ? "{0, 0}};\n" : "\n};\n";
+    c += "const int aot_symbol_count = " + to_string(symbols.size()) + ";\n\n";
+
+    // Instruction addresses, to find where a run starts
+    c += "static const int aot_code[] = {";
+    for (uint32_t i = 0; i < count; i++)
+    {
+        c += (i % 12 == 0 ? "\n    " : " ") + to_string(simulator.instruction(i).lc) + ",";
+    }
+    c += count == 0 ? "0};\n\n" : "\n};\n\n";
+
+    // STEP runs an instruction, CHECK only stops at the step limit
+    c += "#define CHECK(lc) if (left == 0) { state->pc = (lc); status = AOT_STEP_LIMIT; goto done; }\n"
+         "#define STEP(lc) CHECK(lc) left--;\n"
+         "#define FINISH(lc, end_status) { state->pc = (lc); status = (end_status); goto done; }\n\n";
+
+    c += "int aot_run(aot_state *state, uint64_t max_steps, uint64_t *steps)\n{\n"
+         "    uint64_t AREG = (uint64_t)state->registers[1], BREG = (uint64_t)state->registers[2];\n"
+         "    uint64_t CREG = (uint64_t)state->registers[3], DREG = (uint64_t)state->registers[4];\n"
+         "    const int64_t *m = state->memory;\n"
+         "    int zero = state->zero;\n"
+         "    uint64_t left = max_steps;\n"
+         "    int status;\n"
+         "    int low = 0, high = " + to_string(count) + ";\n\n"
+         "    if (state->pc == -1)\n        goto L_extern;\n"
+         "    while (low < high)\n    {\n"
+         "        int middle = low + (high - low) / 2;\n"
+         "        if (aot_code[middle] < state->pc)\n            low = middle + 1;\n"
+         "        else\n            high = middle;\n    }\n"
+         "    switch (low)\n    {\n";
+    for (uint32_t i = 0; i < count; i++)
+    {
+        c += "    case " + to_string(i) + ": goto L" + to_string(simulator.instruction(i).lc) + ";\n";
+    }
+    c += "    default: goto L_end;\n    }\n\n";
+
+    auto label = [&](uint32_t index)
+    {
+        return index == count ? string("L_end") : index > count ? string("L_extern") : "L" + to_string(simulator.instruction(index).lc);
+    };
+    auto memory = [](const SimInstruction &instruction) { return "(uint64_t)m[" + to_string(instruction.operand) + "]"; };
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const SimInstruction &instruction = simulator.instruction(i);
+        string lc = to_string(instruction.lc);
+        string reg = instruction.reg <= 4 ? REGISTER_NAMES[instruction.reg] : "R0";
+        string source = instruction.operand >= 1 && instruction.operand <= 4 ? REGISTER_NAMES[instruction.operand] : "R0";
+        string line = "L" + lc + ":\n    ";
+        bool step = instruction.op < SimOp::END;
+        if (step)
+        {
+            line += "STEP(" + lc + ") ";
+        }
+
+        switch (instruction.op)
+        {
+        case SimOp::MOVER_M:
+            line += reg + " = " + memory(instruction) + ";";
+            break;
+        case SimOp::MOVER_R:
+            line += reg + " = " + source + ";";
+            break;
+        case SimOp::ADD_M:
+            line += reg + " += " + memory(instruction) + ";";
+            break;
+        case SimOp::ADD_R:
+            line += reg + " += " + source + ";";
+            break;
+        case SimOp::SUB_M:
+            line += reg + " -= " + memory(instruction) + ";";
+            break;
+        case SimOp::SUB_R:
+            line += reg + " -= " + source + ";";
+            break;
+        case SimOp::MULT_M:
+            line += reg + " *= " + memory(instruction) + ";";
+            break;
+        case SimOp::MULT_R:
+            line += reg + " *= " + source + ";";
+            break;
+        case SimOp::DIV_M:
+        case SimOp::DIV_R:
+        {
+            string divisor = instruction.op == SimOp::DIV_M ? memory(instruction) : source;
+            line += "if (" + divisor + " == 0) { left++; FINISH(" + lc + ", AOT_DIVIDE_BY_ZERO) }\n    " +
+                    reg + " = (int64_t)" + divisor + " == -1 ? 0 - " + reg + " : (uint64_t)((int64_t)" + reg +
+                    " / (int64_t)" + divisor + ");";
+            break;
+        }
+        case SimOp::COMP_M:
+            line += "zero = " + reg + " == " + memory(instruction) + ";";
+            break;
+        case SimOp::COMP_R:
+            line += "zero = " + reg + " == " + source + ";";
+            break;
+        case SimOp::INCR:
+            line += reg + "++;";
+            break;
+        case SimOp::DECR:
+            line += reg + "--;";
+            break;
+        case SimOp::JMP:
+            line += "goto " + label(instruction.target) + ";";
+            break;
+        case SimOp::JZ:
+            line += "if (zero) goto " + label(instruction.target) + ";";
+            break;
+        case SimOp::JNZ:
+            line += "if (!zero) goto " + label(instruction.target) + ";";
+            break;
+        case SimOp::STOP:
+            line += "FINISH(" + lc + ", AOT_STOPPED)";
+            break;
+        case SimOp::BAD_ADDRESS:
+            line += "CHECK(" + lc + ") FINISH(" + lc + ", AOT_BAD_ADDRESS)";
+            break;
+        default:
+            line += "CHECK(" + lc + ") FINISH(" + lc + ", AOT_ILLEGAL_INSTRUCTION)";
+            break;
+        }
+        c += line + "\n";
+    }
+    c += "L_end:\n    CHECK(" + to_string(end) + ") FINISH(" + to_string(end) + ", AOT_END_OF_CODE)\n";
+    c += "L_extern:\n    CHECK(-1) FINISH(-1, AOT_EXTERN_JUMP)\n";
+    c += "done:\n"
+         "    state->registers[1] = (int64_t)AREG;\n"
+         "    state->registers[2] = (int64_t)BREG;\n"
+         "    state->registers[3] = (int64_t)CREG;\n"
+         "    state->registers[4] = (int64_t)DREG;\n"
+         "    state->zero = zero;\n"
+         "    *steps = max_steps - left;\n"
+         "    return status;\n}\n";
+
+    // The driver of a native executable
+    c += R"(
+#ifdef AOT_MAIN
+static const char *const status_names[] = {"stopped", "end of code", "jump to an EXTERN symbol",
+                                           "illegal instruction", "bad address", "divide by zero",
+                                           "step limit"};
+
+/* Usage: program [--max-steps N] [--set NAME=VALUE]... */
+int main(int argc, char *argv[])
+{
+    aot_state state = {{0}, 0, 0, 0};
+    uint64_t max_steps = UINT64_MAX, steps = 0;
+    struct timespec begin, finish;
+    double seconds;
+    int i, status;
+
+    state.memory = malloc((aot_size > 0 ? aot_size : 1) * sizeof(int64_t));
+    memcpy(state.memory, aot_data, aot_size * sizeof(int64_t));
+    state.pc = aot_entry == -1 ? aot_base + aot_size : aot_entry;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--max-steps") == 0 && i + 1 < argc)
+        {
+            max_steps = strtoull(argv[++i], 0, 10);
+        }
+        else if (strcmp(argv[i], "--set") == 0 && i + 1 < argc)
+        {
+            const char *setting = argv[++i], *equals = strchr(setting, '=');
+            int symbol = -1, s;
+            for (s = 0; equals != 0 && s < aot_symbol_count; s++)
+            {
+                if (strlen(aot_symbols[s].name) == (size_t)(equals - setting) &&
+                    strncmp(aot_symbols[s].name, setting, equals - setting) == 0)
+                {
+                    symbol = s;
+                    break;
+                }
+            }
+            if (symbol == -1 || aot_symbols[symbol].address < aot_base ||
+                aot_symbols[symbol].address >= aot_base + aot_size)
+            {
+                fprintf(stderr, "Error: %s is not a symbol in the program's memory!\n", setting);
+                return 1;
+            }
+            state.memory[aot_symbols[symbol].address - aot_base] = strtoll(equals + 1, 0, 10);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--max-steps N] [--set NAME=VALUE]...\n", argv[0]);
+            return 1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    status = aot_run(&state, max_steps, &steps);
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    seconds = (finish.tv_sec - begin.tv_sec) + (finish.tv_nsec - begin.tv_nsec) / 1e9;
+
+    printf("Status:        %s", status_names[status]);
+    if (state.pc != -1 && status != AOT_END_OF_CODE)
+    {
+        printf(" at %d", state.pc);
+    }
+    printf("\nInstructions:  %" PRIu64 "\n", steps);
+    printf("Registers:     AREG %" PRId64 "  BREG %" PRId64 "  CREG %" PRId64 "  DREG %" PRId64 "\n",
+           state.registers[1], state.registers[2], state.registers[3], state.registers[4]);
+    printf("Condition:     %s\n", state.zero ? "zero" : "not zero");
+    printf("Time (ms):     %.2f\n", seconds * 1000);
+    printf("Instr/sec:     %.0f\n", steps / (seconds > 1e-9 ? seconds : 1e-9));
+    free(state.memory);
+    return status == AOT_STOPPED || status == AOT_END_OF_CODE ? 0 : 2;
+}
+#endif
+)";
+    return c;
+}
+
+// Returns the C translation of an assembled module
+inline string translateToC(const ObjectModule &module, string_view name)
+{
+    return translateToC(loadImage(module), module.symbol_table, name);
+}
+
+inline string shellQuote(string_view text)
+{
+    string quoted = "'";
+    for (char c : text)
+    {
+        quoted += c == '\'' ? string("'\\''") : string(1, c);
+    }
+    return quoted + "'";
+}
+
+// Builds a C file written by translateToC() with the system C compiler:
+// an executable with its main(), or a shared object for dlopen(). False if
+// the compiler failed.
+inline bool compileC(const string &c_file, const string &output, bool shared, const string &compiler = "cc")
+{
+    string command = compiler + " -O2 -std=c99 -w " + (shared ? "-shared -fPIC " : "-DAOT_MAIN ") +
+                     "-o " + shellQuote(output) + " " + shellQuote(c_file);
+    return system(command.c_str()) == 0;
+}
@@ -0,0 +1,867 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include "assembler.h"
+#include "object_file.h"
+#include "output_writer.h"
+
+using namespace std;
+
+// What the previous run knew about one source line. The cache keeps one per
+// line plus one for the end of the source.
+struct LineState
+{
+    enum Flags : uint32_t
+    {
+        SET1 = 1,   // pass 1 LC after the line is absolute (START)
+        SET2 = 2,   // pass 2 LC after the line is absolute (START/ORIGIN)
+        LAYOUT = 4, // defines a label, literal or symbol, flushes a pool or is a link directive
+        AT_LC = 8   // pass 2 added a symbol at the line's LC
+    };
+
+    uint64_t hash;            // of the line text
+    int32_t lc1;              // pass 1 LC before the line
+    int32_t lc2;              // pass 2 LC before the line
+    uint32_t labels_before;   // symbols entered by pass 1 before the line
+    uint32_t symbols_before;  // symbols in the table when pass 2 reaches the line
+    uint32_t literals_before; // literals entered by pass 1 before the line
+    uint32_t pool;            // literal pools flushed before the line
+    uint32_t first_record;    // intermediate code records before the line
+    uint32_t flags;
+};
+
+static_assert(sizeof(LineState) == 40, "LineState is stored in the cache as is");
+
+// After the object file part of a cache come the patches of the runs that
+// only changed entries in place, oldest first. Each patch replaces count
+// entries of one section from first on, the entries following it padded to
+// 8 bytes; a commit closes the patches of one run, which only count once it
+// is written completely.
+struct CachePatch
+{
+    uint32_t magic; // CACHE_PATCH
+    uint32_t type;  // SectionType of the entries
+    uint32_t first;
+    uint32_t count;
+};
+
+struct CacheCommit
+{
+    uint32_t magic; // CACHE_COMMIT
+    uint32_t size;  // bytes of the run's patches before it
+    uint64_t hash;  // of those bytes
+};
+
+const uint32_t CACHE_PATCH = 0x48435450;  // "PTCH"
+const uint32_t CACHE_COMMIT = 0x54494d43; // "CMIT"
+
+// Two-pass assembly that keeps a per-line cache file between runs. When the
+// lines that changed since the cached run neither define nor flush anything
+// (no labels, new symbols or literals, START/ORIGIN/LTORG/END or link
+// directives), only those lines are translated again: every table keeps its
+// indices, and LCs, label and literal addresses are propagated from the first
+// changed line with the deltas in the cache, up to the line where they meet
+// the cached LCs again. Any other edit, or a missing or unreadable cache,
+// assembles the whole source. The result is always the same as
+// Assembler::assemble().
+//
+// An edit that keeps the line and record counts appends what it changed to
+// the cache (see CachePatch); anything else rewrites it. The patches only
+// cover what loadCache() reads, so the RELOCATIONS and LINKS sections of a
+// patched cache may be stale.
+class IncrementalAssembler
+{
+private:
+    Assembler core;
+    vector<LineState> states;
+
+    // What the cache file holds and what has changed since it was read
+    struct CacheChanges
+    {
+        bool whole = true;       // rewrite the cache instead of appending
+        size_t base_size = 0;    // bytes of the object file part
+        size_t patch_size = 0;   // bytes of committed patches after it
+        size_t first_line = 0;   // line states [first_line, end_line) changed
+        size_t end_line = 0;
+        size_t first_record = 0; // records [first_record, end_record) changed
+        size_t end_record = 0;
+        vector<uint32_t> rows;   // more machine code rows whose operand moved
+        vector<uint32_t> symbols, literals; // whose address changed
+    };
+    CacheChanges changes;
+    bool cache_written = false;
+
+    static uint64_t hashLine(string_view line)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : line)
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static vector<string_view> splitLines(string_view source)
+    {
+        vector<string_view> lines;
+        string_view line;
+        size_t position = 0;
+        while (nextLine(source, position, line))
+        {
+            lines.push_back(line);
+        }
+        return lines;
+    }
+
+    // Both passes line by line, recording the state before every line
+    void assembleAll(const vector<string_view> &lines)
+    {
+        core.reset();
+        states.assign(lines.size() + 1, LineState());
+        changes = CacheChanges();
+
+        // Pass 1
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            LineState &state = states[i];
+            state.hash = hashLine(lines[i]);
+            state.lc1 = core.lc;
+            state.labels_before = core.symbol_table.size();
+            state.literals_before = core.literal_table.size();
+
+            Assembler::Pass1Line decoded = core.scanLine(lines[i]);
+            core.firstPass(lines[i]);
+
+            bool defined = core.symbol_table.size() != state.labels_before;
+            if (decoded.effect == Assembler::Pass1Line::SET && !decoded.literal_only &&
+                (decoded.label.empty() || defined))
+            {
+                state.flags |= LineState::SET1 | LineState::LAYOUT;
+            }
+            if (!decoded.label.empty() || decoded.literal_only || decoded.closes_pool ||
+                core.literal_table.size() != state.literals_before)
+            {
+                state.flags |= LineState::LAYOUT;
+            }
+        }
+        LineState &end = states.back();
+        end.lc1 = core.lc;
+        end.labels_before = core.symbol_table.size();
+        end.literals_before = core.literal_table.size();
+
+        // Pass 2 as one chunk, noting where every line starts in it
+        Assembler::Pass2Chunk chunk;
+        vector<size_t> segment_of(lines.size() + 1), relative_lc(lines.size() + 1), deferred_from(lines.size() + 1);
+        for (size_t i = 0; i <= lines.size(); i++)
+        {
+            segment_of[i] = chunk.segments.size() - 1;
+            relative_lc[i] = chunk.lc;
+            deferred_from[i] = chunk.deferred.size();
+            states[i].first_record = chunk.records.size();
+            if (i == lines.size())
+            {
+                break;
+            }
+
+            size_t segments = chunk.segments.size();
+            size_t links = chunk.links.size();
+            core.secondPass(lines[i], chunk);
+
+            for (size_t s = segments; s < chunk.segments.size(); s++)
+            {
+                states[i].flags |= LineState::LAYOUT;
+                if (chunk.segments[s].start == Assembler::LcSegment::SET)
+                {
+                    states[i].flags |= LineState::SET2;
+                }
+            }
+            if (chunk.links.size() != links)
+            {
+                states[i].flags |= LineState::LAYOUT;
+            }
+        }
+
+        size_t labels = core.symbol_table.size();
+        size_t literals = core.literal_table.size();
+        core.resolveChunk(chunk);
+
+        uint32_t pool = 0;
+        size_t segment = 0;
+        uint32_t symbols = labels;
+        for (size_t i = 0; i <= lines.size(); i++)
+        {
+            for (; segment < segment_of[i]; segment++)
+            {
+                pool += chunk.segments[segment + 1].start == Assembler::LcSegment::FLUSH;
+            }
+
+            LineState &state = states[i];
+            state.lc2 = chunk.segments[segment_of[i]].base + relative_lc[i];
+            state.pool = pool;
+            state.symbols_before = symbols;
+            if (i == lines.size())
+            {
+                break;
+            }
+
+            // Symbols and literals pass 2 had to add
+            for (size_t d = deferred_from[i]; d < deferred_from[i + 1]; d++)
+            {
+                const auto &operand = chunk.deferred[d];
+                int value = chunk.records[operand.record].value;
+                if (operand.kind == Assembler::DeferredOperand::LITERAL)
+                {
+                    if ((size_t)value > literals)
+                    {
+                        state.flags |= LineState::LAYOUT;
+                    }
+                }
+                else if (operand.kind != Assembler::DeferredOperand::SYMBOL_COUNT && (uint32_t)value > symbols)
+                {
+                    symbols = value;
+                    state.flags |= LineState::LAYOUT;
+                    if (operand.kind == Assembler::DeferredOperand::SYMBOL_AT_LC)
+                    {
+                        state.flags |= LineState::AT_LC;
+                    }
+                }
+            }
+        }
+
+        core.intermediate_code.resize(chunk.records.size());
+        core.placeChunk(chunk, 0);
+        core.generateMachineCode();
+    }
+
+    // Listing row of a record, from its code word in the cache; the same as
+    // Assembler::machineInstruction()
+    static MachineInstruction listingRow(const CodeWord &word)
+    {
+        MachineInstruction row = {word.lc, word.opcode, word.reg, 0, false};
+        if (word.reg != 0 && (word.kind == (uint8_t)OperandKind::SYMBOL || word.kind == (uint8_t)OperandKind::LITERAL ||
+                              word.kind == (uint8_t)OperandKind::REGISTER))
+        {
+            row.operand = word.operand;
+            row.has_operand = true;
+        }
+        return row;
+    }
+
+    static size_t patchEntrySize(uint32_t type)
+    {
+        switch ((SectionType)type)
+        {
+        case SectionType::SOURCE_LINES:
+            return sizeof(LineState);
+        case SectionType::INTERMEDIATE:
+            return sizeof(ICRecord);
+        case SectionType::CODE:
+            return sizeof(CodeWord);
+        case SectionType::SYMBOL_ADDRESSES:
+        case SectionType::LITERAL_ADDRESSES:
+            return sizeof(int32_t);
+        default:
+            return 0;
+        }
+    }
+
+    // Applies one patch to the loaded cache, false if it does not fit
+    bool applyPatch(const CachePatch &patch, const char *entries)
+    {
+        size_t sizes[] = {states.size(), core.intermediate_code.size(), core.machine_code.size(),
+                          core.symbol_table.size(), core.literal_table.size()};
+        SectionType types[] = {SectionType::SOURCE_LINES, SectionType::INTERMEDIATE, SectionType::CODE,
+                               SectionType::SYMBOL_ADDRESSES, SectionType::LITERAL_ADDRESSES};
+        size_t target = find(begin(types), end(types), (SectionType)patch.type) - begin(types);
+        if (target == size(types) || patch.first > sizes[target] || patch.count > sizes[target] - patch.first)
+        {
+            return false;
+        }
+
+        size_t entry_size = patchEntrySize(patch.type);
+        for (size_t i = 0; i < patch.count; i++)
+        {
+            const char *entry = entries + i * entry_size;
+            size_t index = patch.first + i;
+            switch ((SectionType)patch.type)
+            {
+            case SectionType::SOURCE_LINES:
+                memcpy(&states[index], entry, sizeof(LineState));
+                break;
+            case SectionType::INTERMEDIATE:
+                memcpy(&core.intermediate_code[index], entry, sizeof(ICRecord));
+                break;
+            case SectionType::CODE:
+            {
+                CodeWord word;
+                memcpy(&word, entry, sizeof(word));
+                core.machine_code[index] = listingRow(word);
+                break;
+            }
+            case SectionType::SYMBOL_ADDRESSES:
+                memcpy(&core.symbol_table[index].second, entry, sizeof(int32_t));
+                break;
+            default:
+                memcpy(&core.literal_table[index].address, entry, sizeof(int32_t));
+                break;
+            }
+        }
+        return true;
+    }
+
+    // Applies the committed runs of patches in the trailer of a cache and
+    // returns the bytes they take, or -1 if one does not fit the cache. A
+    // run cut short by a failed write ends the patches.
+    ptrdiff_t applyPatches(string_view trailer)
+    {
+        size_t committed = 0;
+        size_t position = 0;
+        while (trailer.size() - position >= sizeof(CachePatch))
+        {
+            CachePatch patch;
+            memcpy(&patch, trailer.data() + position, sizeof(patch));
+            if (patch.magic == CACHE_PATCH)
+            {
+                size_t entry_size = patchEntrySize(patch.type);
+                size_t bytes = ((uint64_t)patch.count * entry_size + 7) & ~uint64_t(7);
+                if (entry_size == 0 || bytes > trailer.size() - position - sizeof(patch))
+                {
+                    break;
+                }
+                position += sizeof(patch) + bytes;
+                continue;
+            }
+
+            CacheCommit commit;
+            memcpy(&commit, trailer.data() + position, sizeof(commit));
+            string_view run = trailer.substr(committed, position - committed);
+            if (commit.magic != CACHE_COMMIT || commit.size != run.size() || commit.hash != hashLine(run))
+            {
+                break;
+            }
+            for (size_t at = 0; at < run.size();)
+            {
+                memcpy(&patch, run.data() + at, sizeof(patch));
+                if (!applyPatch(patch, run.data() + at + sizeof(patch)))
+                {
+                    return -1;
+                }
+                at += sizeof(patch) + ((patch.count * patchEntrySize(patch.type) + 7) & ~size_t(7));
+            }
+            position += sizeof(commit);
+            committed = position;
+        }
+        return committed;
+    }
+
+    // Loads the tables, the intermediate code, the machine code and the line
+    // states of a cache
+    bool loadCache(const string &cache_file)
+    {
+        changes = CacheChanges();
+        ObjectFile cache;
+        if (!cache.open(cache_file))
+        {
+            return false;
+        }
+
+        auto lines = cache.section<LineState>(SectionType::SOURCE_LINES);
+        auto records = cache.section<ICRecord>(SectionType::INTERMEDIATE);
+        auto code = cache.code();
+        auto pool_starts = cache.section<uint32_t>(SectionType::LITERAL_POOLS);
+        auto symbols = cache.symbols();
+        auto literals = cache.literals();
+        if (lines.empty() || pool_starts.empty() || lines[lines.size() - 1].first_record != records.size() ||
+            code.size() != records.size())
+        {
+            return false;
+        }
+
+        core.reset();
+        for (const auto &symbol : symbols)
+        {
+            core.symbol_table.add(cache.name(symbol.name_offset, symbol.name_length), symbol.address);
+        }
+        for (size_t pool = 0; pool < pool_starts.size(); pool++)
+        {
+            size_t last = pool + 1 < pool_starts.size() ? pool_starts[pool + 1] : literals.size();
+            if (pool_starts[pool] > last || last > literals.size())
+            {
+                return false;
+            }
+            for (size_t i = pool_starts[pool]; i < last; i++)
+            {
+                core.literal_table.add(cache.name(literals[i].name_offset, literals[i].name_length));
+                core.literal_table[i].address = literals[i].address;
+            }
+            if (pool + 1 < pool_starts.size())
+            {
+                core.literal_table.closePool();
+            }
+        }
+        core.pool_table.assign(cache.pools().begin(), cache.pools().end());
+        for (const auto &link : cache.links())
+        {
+            core.link_records.push_back({string(cache.name(link.name_offset, link.name_length)), (LinkType)link.type});
+        }
+        core.intermediate_code.assign(records.begin(), records.end());
+        core.machine_code.reserve(code.size());
+        for (const auto &word : code)
+        {
+            core.machine_code.push_back(listingRow(word));
+        }
+        states.assign(lines.begin(), lines.end());
+
+        string_view trailer = cache.trailer();
+        ptrdiff_t committed = applyPatches(trailer);
+        if (committed < 0)
+        {
+            return false;
+        }
+        changes.base_size = cache.size() - trailer.size();
+        changes.patch_size = committed;
+        // A torn run has to go before anything is appended after it
+        changes.whole = (size_t)committed != trailer.size();
+
+        for (size_t i = 0; i < states.size(); i++)
+        {
+            const LineState &state = states[i];
+            if ((i + 1 < states.size() && state.first_record > states[i + 1].first_record) ||
+                state.labels_before > core.symbol_table.size() || state.symbols_before > core.symbol_table.size() ||
+                state.literals_before > core.literal_table.size() || state.pool >= core.literal_table.poolCount())
+            {
+                return false;
+            }
+        }
+        if (states.back().first_record != core.intermediate_code.size())
+        {
+            return false;
+        }
+
+        // Every index the records use must be in the tables
+        for (const auto &ic : core.intermediate_code)
+        {
+            if ((ic.kind == OperandKind::SYMBOL && (ic.value < 1 || (size_t)ic.value > core.symbol_table.size())) ||
+                (ic.kind == OperandKind::LITERAL && (ic.value < 1 || (size_t)ic.value > core.literal_table.size())))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // LC advance and record count of a changed line
+    struct ChangedLine
+    {
+        int lc1_delta;
+        int lc2_delta;
+        uint32_t records;
+    };
+
+    // Translates a changed line against the cached tables. Returns false if
+    // the line would change a table or the layout.
+    bool translateLine(string_view line, const LineState &context, vector<ICRecord> &records, ChangedLine &changed)
+    {
+        Assembler::Pass1Line decoded = core.scanLine(line);
+        if (!decoded.label.empty() || decoded.literal_only || decoded.closes_pool ||
+            decoded.effect == Assembler::Pass1Line::SET)
+        {
+            return false;
+        }
+
+        // A literal may only be shared with one entered before the line
+        if (!decoded.literal.empty())
+        {
+            int literal_number = core.literal_table.find(context.pool, decoded.literal);
+            if (literal_number == 0 || (uint32_t)literal_number > context.literals_before)
+            {
+                return false;
+            }
+        }
+
+        Assembler::Pass2Chunk chunk;
+        core.secondPass(line, chunk);
+        if (chunk.segments.size() != 1 || !chunk.links.empty())
+        {
+            return false;
+        }
+
+        // Symbols pass 2 adds later in the source would be added here instead
+        for (const auto &ic : chunk.records)
+        {
+            if (ic.kind == OperandKind::SYMBOL && (uint32_t)ic.value > context.symbols_before)
+            {
+                return false;
+            }
+        }
+        for (const auto &operand : chunk.deferred)
+        {
+            ICRecord &ic = chunk.records[operand.record];
+            if (operand.kind == Assembler::DeferredOperand::LITERAL)
+            {
+                ic.value = core.literal_table.find(context.pool, operand.name);
+                if (ic.value == 0 || (uint32_t)ic.value > context.literals_before)
+                {
+                    return false;
+                }
+            }
+            else if (operand.kind == Assembler::DeferredOperand::SYMBOL_COUNT)
+            {
+                ic.value = context.symbols_before;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        records.insert(records.end(), chunk.records.begin(), chunk.records.end());
+        changed = {decoded.value, chunk.lc, (uint32_t)chunk.records.size()};
+        return true;
+    }
+
+    // Replaces items [first, last) with the range [from, to), moving the
+    // items after them at most once
+    template <typename T, typename Iterator>
+    static void splice(vector<T> &items, size_t first, size_t last, Iterator from, Iterator to)
+    {
+        size_t count = to - from;
+        if (last - first > count)
+        {
+            items.erase(items.begin() + first + count, items.begin() + last);
+        }
+        else if (last - first < count)
+        {
+            items.insert(items.begin() + last, count - (last - first), T());
+        }
+        copy(from, to, items.begin() + first);
+    }
+
+    // Splices the changed lines into the cached run and propagates LCs and
+    // addresses from the first changed line on, until they are the cached
+    // ones again
+    bool update(const vector<string_view> &lines)
+    {
+        vector<uint64_t> hashes;
+        hashes.reserve(lines.size());
+        for (string_view line : lines)
+        {
+            hashes.push_back(hashLine(line));
+        }
+
+        size_t old_count = states.size() - 1;
+        size_t prefix = 0;
+        while (prefix < lines.size() && prefix < old_count && states[prefix].hash == hashes[prefix])
+        {
+            prefix++;
+        }
+        size_t suffix = 0;
+        while (suffix < lines.size() - prefix && suffix < old_count - prefix &&
+               states[old_count - 1 - suffix].hash == hashes[lines.size() - 1 - suffix])
+        {
+            suffix++;
+        }
+
+        // The replaced lines must not have defined anything either
+        for (size_t i = prefix; i < old_count - suffix; i++)
+        {
+            if (states[i].flags & LineState::LAYOUT)
+            {
+                return false;
+            }
+        }
+
+        const LineState context = states[prefix];
+        size_t changed_count = lines.size() - suffix - prefix;
+        vector<ICRecord> records;
+        vector<ChangedLine> changed(changed_count);
+        for (size_t i = 0; i < changed_count; i++)
+        {
+            if (!translateLine(lines[prefix + i], context, records, changed[i]))
+            {
+                return false;
+            }
+        }
+
+        // States of the changed lines, and LCs of their records
+        vector<LineState> changed_states;
+        int lc1 = context.lc1;
+        int lc2 = context.lc2;
+        uint32_t record = context.first_record;
+        for (size_t i = 0; i < changed_count; i++)
+        {
+            LineState state = context;
+            state.hash = hashes[prefix + i];
+            state.flags = 0;
+            state.lc1 = lc1;
+            state.lc2 = lc2;
+            state.first_record = record;
+            changed_states.push_back(state);
+
+            for (uint32_t r = record; r < record + changed[i].records; r++)
+            {
+                records[r - context.first_record].lc = lc2;
+            }
+            record += changed[i].records;
+            lc1 += changed[i].lc1_delta;
+            lc2 += changed[i].lc2_delta;
+        }
+
+        // Splice them in place of the replaced lines; the rows are made below
+        size_t old_end = old_count - suffix;
+        uint32_t old_end_record = states[old_end].first_record;
+        int old_last_lc1 = states.back().lc1;
+        int32_t record_shift = (int32_t)records.size() - (int32_t)(old_end_record - context.first_record);
+        vector<MachineInstruction> rows(records.size());
+        splice(core.intermediate_code, context.first_record, old_end_record, records.begin(), records.end());
+        splice(core.machine_code, context.first_record, old_end_record, rows.begin(), rows.end());
+        splice(states, prefix, old_end, changed_states.begin(), changed_states.end());
+
+        // Propagate through the unchanged lines after them, with the deltas
+        // of the cached run, until the LCs are the cached ones again
+        vector<uint32_t> &moved_symbols = changes.symbols;
+        vector<uint32_t> &moved_literals = changes.literals;
+        size_t line = prefix + changed_count;
+        for (; line < states.size(); line++)
+        {
+            LineState &state = states[line];
+            if (state.lc1 == lc1 && state.lc2 == lc2)
+            {
+                break;
+            }
+            const LineState old_state = state;
+            state.lc1 = lc1;
+            state.lc2 = lc2;
+            state.first_record = record;
+            if (line + 1 == states.size())
+            {
+                continue;
+            }
+
+            const LineState &old_next = states[line + 1];
+            uint32_t records_here = old_next.first_record - old_state.first_record;
+
+            if (old_next.labels_before != old_state.labels_before &&
+                core.symbol_table[old_state.labels_before].second != lc1)
+            {
+                core.symbol_table[old_state.labels_before].second = lc1;
+                moved_symbols.push_back(old_state.labels_before);
+            }
+            if ((old_state.flags & LineState::AT_LC) && core.symbol_table[old_state.symbols_before].second != lc2)
+            {
+                core.symbol_table[old_state.symbols_before].second = lc2;
+                moved_symbols.push_back(old_state.symbols_before);
+            }
+            if (!(old_state.flags & LineState::SET2))
+            {
+                for (uint32_t r = record; r < record + records_here; r++)
+                {
+                    core.intermediate_code[r].lc = lc2;
+                }
+            }
+            if (old_next.pool != old_state.pool)
+            {
+                // LTORG/END places the pool right after itself
+                auto range = core.literal_table.poolRange(old_state.pool);
+                for (size_t l = range.first; l < range.second; l++)
+                {
+                    if (core.literal_table[l].address != lc2 + (int)(l - range.first))
+                    {
+                        core.literal_table[l].address = lc2 + (l - range.first);
+                        moved_literals.push_back(l);
+                    }
+                }
+            }
+
+            record += records_here;
+            lc1 = (old_state.flags & LineState::SET1) ? old_next.lc1 : lc1 + (old_next.lc1 - old_state.lc1);
+            lc2 = (old_state.flags & LineState::SET2) ? old_next.lc2 : lc2 + (old_next.lc2 - old_state.lc2);
+        }
+
+        // Pass 2 starts at the LC pass 1 ended with, so the cached pass 2
+        // LCs before the first START/ORIGIN, and the start of pass 2 kept
+        // in the first line's state, only hold while pass 1 still ends there
+        if (states.back().lc1 != old_last_lc1)
+        {
+            return false;
+        }
+        for (size_t i = line; i < states.size(); i++)
+        {
+            states[i].first_record += record_shift;
+        }
+
+        // Rows of the records that moved, and of the records using an
+        // address that did
+        for (uint32_t r = context.first_record; r < record; r++)
+        {
+            core.machine_code[r] = core.machineInstruction(core.intermediate_code[r]);
+        }
+        if (!moved_symbols.empty() || !moved_literals.empty())
+        {
+            vector<bool> symbol_moved(core.symbol_table.size()), literal_moved(core.literal_table.size());
+            for (uint32_t symbol : moved_symbols)
+            {
+                symbol_moved[symbol] = true;
+            }
+            for (uint32_t literal : moved_literals)
+            {
+                literal_moved[literal] = true;
+            }
+            auto refresh = [&](uint32_t first, uint32_t last)
+            {
+                for (uint32_t r = first; r < last; r++)
+                {
+                    const ICRecord &ic = core.intermediate_code[r];
+                    if ((ic.kind == OperandKind::SYMBOL && symbol_moved[ic.value - 1]) ||
+                        (ic.kind == OperandKind::LITERAL && literal_moved[ic.value - 1]))
+                    {
+                        core.machine_code[r] = core.machineInstruction(ic);
+                        changes.rows.push_back(r);
+                    }
+                }
+            };
+            refresh(0, context.first_record);
+            refresh(record, core.intermediate_code.size());
+        }
+
+        changes.whole = changes.whole || changed_count != old_end - prefix || record_shift != 0;
+        changes.first_line = prefix;
+        changes.end_line = line;
+        changes.first_record = context.first_record;
+        changes.end_record = record;
+        return true;
+    }
+
+    // Appends a patch of entries [first, last), entry(i) giving entry i
+    template <typename Entry>
+    static void addPatch(string &patches, SectionType type, size_t first, size_t last, Entry entry)
+    {
+        if (first == last)
+        {
+            return;
+        }
+        CachePatch patch = {CACHE_PATCH, (uint32_t)type, (uint32_t)first, (uint32_t)(last - first)};
+        patches.append((const char *)&patch, sizeof(patch));
+        for (size_t i = first; i < last; i++)
+        {
+            auto value = entry(i);
+            patches.append((const char *)&value, sizeof(value));
+        }
+        patches.resize((patches.size() + 7) & ~size_t(7), '\0');
+    }
+
+    // Appends a patch per run of consecutive indices
+    template <typename Entry>
+    static void addPatches(string &patches, SectionType type, vector<uint32_t> &indices, Entry entry)
+    {
+        sort(indices.begin(), indices.end());
+        indices.erase(unique(indices.begin(), indices.end()), indices.end());
+        for (size_t i = 0; i < indices.size();)
+        {
+            size_t j = i + 1;
+            while (j < indices.size() && indices[j] == indices[j - 1] + 1)
+            {
+                j++;
+            }
+            addPatch(patches, type, indices[i], indices[j - 1] + 1, entry);
+            i = j;
+        }
+    }
+
+    // Appends what update() changed to the cache, false if it has to be
+    // written whole instead
+    bool appendToCache(const ObjectModule &module, const string &cache_file)
+    {
+        const SymbolTable &symbols = module.symbol_table;
+        const LiteralTable &literals = module.literal_table;
+        const vector<ICRecord> &records = module.intermediate_code;
+
+        string patches;
+        addPatch(patches, SectionType::SOURCE_LINES, changes.first_line, changes.end_line,
+                 [&](size_t i) { return states[i]; });
+        addPatch(patches, SectionType::INTERMEDIATE, changes.first_record, changes.end_record,
+                 [&](size_t i) { return records[i]; });
+        addPatch(patches, SectionType::CODE, changes.first_record, changes.end_record,
+                 [&](size_t i) { return codeWord(records[i], symbols, literals); });
+        addPatches(patches, SectionType::CODE, changes.rows,
+                   [&](size_t i) { return codeWord(records[i], symbols, literals); });
+        addPatches(patches, SectionType::SYMBOL_ADDRESSES, changes.symbols,
+                   [&](size_t i) { return (int32_t)symbols[i].second; });
+        addPatches(patches, SectionType::LITERAL_ADDRESSES, changes.literals,
+                   [&](size_t i) { return (int32_t)literals[i].address; });
+        if (patches.empty())
+        {
+            return true;
+        }
+
+        // Past a quarter of the cache the patches cost more to load than a
+        // rewrite does to write
+        if (changes.patch_size + patches.size() > changes.base_size / 4)
+        {
+            return false;
+        }
+        CacheCommit commit = {CACHE_COMMIT, (uint32_t)patches.size(), hashLine(patches)};
+        patches.append((const char *)&commit, sizeof(commit));
+
+        OutputWriter out(cache_file, 1 << 16, true);
+        out.write(patches);
+        return out.flush();
+    }
+
+    bool saveCache(const ObjectModule &module, const string &cache_file)
+    {
+        if (!changes.whole && appendToCache(module, cache_file))
+        {
+            return true;
+        }
+
+        vector<uint32_t> pool_starts;
+        for (size_t pool = 0; pool < module.literal_table.poolCount(); pool++)
+        {
+            pool_starts.push_back(module.literal_table.poolRange(pool).first);
+        }
+
+        vector<ObjectSection> extra = {
+            {SectionType::INTERMEDIATE, module.intermediate_code.data(), module.intermediate_code.size() * sizeof(ICRecord), module.intermediate_code.size()},
+            {SectionType::LITERAL_POOLS, pool_starts.data(), pool_starts.size() * sizeof(uint32_t), pool_starts.size()},
+            {SectionType::SOURCE_LINES, states.data(), states.size() * sizeof(LineState), states.size()}};
+
+        // Replace the old cache only once the new one is complete
+        string temporary = cache_file + ".tmp";
+        if (!writeObjectFile(module, temporary, extra))
+        {
+            remove(temporary.c_str());
+            return false;
+        }
+        return rename(temporary.c_str(), cache_file.c_str()) == 0;
+    }
+
+public:
+    IncrementalAssembler(AssemblerOptions options = AssemblerOptions()) : core(options) {}
+
+    // Assembles source, reusing cache_file from the previous run if it has
+    // one, and writes the cache for the next run
+    ObjectModule assemble(string_view source, const string &cache_file)
+    {
+        vector<string_view> lines = splitLines(source);
+
+        if (!loadCache(cache_file) || !update(lines))
+        {
+            assembleAll(lines);
+        }
+
+        ObjectModule module = core.finish();
+        cache_written = saveCache(module, cache_file);
+        return module;
+    }
+
+    // Whether the last assemble() call could write the cache
+    bool cacheWritten() const { return cache_written; }
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+enum class OpClass : uint8_t
+{
+    IS,
+    AD,
+    DL
+};
+
+enum class OperandKind : uint8_t
+{
+    NONE,
+    REGISTER,
+    SYMBOL,
+    LITERAL,
+    CONSTANT
+};
+
+// One line of intermediate code packed into 12 bytes. Pass 2 fills these in
+// and the machine code is generated straight from the fields; the
+// "(IS,1) (R,1) (S,3)" text form is only built for the listing.
+struct ICRecord
+{
+    int32_t lc;
+    OpClass op_class;
+    uint8_t opcode;
+    uint8_t reg;      // register of an (R,n) first operand, 0 if there is none
+    OperandKind kind; // kind of the remaining operand
+    int32_t value;    // register code, 1-based symbol/literal index or constant
+};
+
+inline const char *opClassName(OpClass op_class)
+{
+    switch (op_class)
+    {
+    case OpClass::IS:
+        return "IS";
+    case OpClass::AD:
+        return "AD";
+    default:
+        return "DL";
+    }
+}
+
+inline string icToString(const ICRecord &ic)
+{
+    string text = "(" + string(opClassName(ic.op_class)) + "," + to_string(ic.opcode) + ")";
+
+    if (ic.reg != 0)
+    {
+        text += " (R," + to_string(ic.reg) + ")";
+    }
+
+    switch (ic.kind)
+    {
+    case OperandKind::REGISTER:
+        text += " (R," + to_string(ic.value) + ")";
+        break;
+    case OperandKind::SYMBOL:
+        text += " (S," + to_string(ic.value) + ")";
+        break;
+    case OperandKind::LITERAL:
+        text += " (L," + to_string(ic.value) + ")";
+        break;
+    case OperandKind::CONSTANT:
+        text += " (C," + to_string(ic.value) + ")";
+        break;
+    default:
+        break;
+    }
+    return text;
+}
@@ -0,0 +1,356 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LINE_SCANNER_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+// GCC and Clang compile the AVX2 kernel for its own target and pick it at run time
+#define LINE_SCANNER_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+using namespace std;
+
+// Source lines split into tokens in one sweep over the buffer. Instead of
+// searching every line for its end and then for each delimiter, the scanner
+// classifies 64 bytes at a time into a bit mask of separators (space, comma,
+// newline) and a mask of newlines, and walks only the bits where a token
+// starts or ends. The classification has a scalar, an SSE2 and an AVX2
+// kernel; the best one the CPU supports is chosen once at run time.
+//
+// Lines and tokens match nextLine() and splitTokens(line, " ,", tokens, 4):
+// a line ends at "\n" or "\r\n" (or the end of the text), at most four tokens
+// are kept per line and unused token slots are empty.
+
+const int MAX_LINE_TOKENS = 4;
+
+struct TokenizedLine
+{
+    string_view text;                    // the line without its line ending
+    string_view tokens[MAX_LINE_TOKENS]; // empty past count
+    int count = 0;
+};
+
+enum class ScanKernel
+{
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+// Bits of one 64-byte block, bit i for byte i
+struct ByteClasses
+{
+    uint64_t separators; // ' ', ',' and '\n'
+    uint64_t newlines;
+};
+
+// Index of the lowest set bit of a non-zero mask
+inline int lowestBit(uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return index;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+inline ByteClasses classifyScalar(const char *block)
+{
+    ByteClasses classes = {0, 0};
+    for (int i = 0; i < 64; i++)
+    {
+        char c = block[i];
+        uint64_t bit = uint64_t(1) << i;
+        if (c == ' ' || c == ',' || c == '\n')
+        {
+            classes.separators |= bit;
+        }
+        if (c == '\n')
+        {
+            classes.newlines |= bit;
+        }
+    }
+    return classes;
+}
+
+#ifdef LINE_SCANNER_SSE2
+inline ByteClasses classifySse2(const char *block)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    ByteClasses classes = {0, 0};
+    for (int i = 0; i < 4; i++)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(block + i * 16));
+        __m128i is_newline = _mm_cmpeq_epi8(bytes, newline);
+        __m128i is_separator = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, space), _mm_cmpeq_epi8(bytes, comma)), is_newline);
+        classes.separators |= uint64_t((uint16_t)_mm_movemask_epi8(is_separator)) << (i * 16);
+        classes.newlines |= uint64_t((uint16_t)_mm_movemask_epi8(is_newline)) << (i * 16);
+    }
+    return classes;
+}
+#endif
+
+#ifdef LINE_SCANNER_AVX2
+__attribute__((target("avx2"))) inline ByteClasses classifyAvx2(const char *block)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    ByteClasses classes = {0, 0};
+    for (int i = 0; i < 2; i++)
+    {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(block + i * 32));
+        __m256i is_newline = _mm256_cmpeq_epi8(bytes, newline);
+        __m256i is_separator = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, space), _mm256_cmpeq_epi8(bytes, comma)), is_newline);
+        classes.separators |= uint64_t((uint32_t)_mm256_movemask_epi8(is_separator)) << (i * 32);
+        classes.newlines |= uint64_t((uint32_t)_mm256_movemask_epi8(is_newline)) << (i * 32);
+    }
+    return classes;
+}
+#endif
+
+// The fastest kernel this CPU runs
+inline ScanKernel bestScanKernel()
+{
+#ifdef LINE_SCANNER_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return ScanKernel::AVX2;
+    }
+#endif
+#ifdef LINE_SCANNER_SSE2
+    return ScanKernel::SSE2;
+#else
+    return ScanKernel::SCALAR;
+#endif
+}
+
+inline bool scanKernelSupported(ScanKernel kernel)
+{
+    switch (kernel)
+    {
+    case ScanKernel::AVX2:
+        return bestScanKernel() == ScanKernel::AVX2;
+    case ScanKernel::SSE2:
+        return bestScanKernel() != ScanKernel::SCALAR;
+    default:
+        return true;
+    }
+}
+
+// Kernel used by default, picked on first use
+inline ScanKernel &activeScanKernel()
+{
+    static ScanKernel kernel = bestScanKernel();
+    return kernel;
+}
+
+inline ByteClasses classifyBlock(const char *block, ScanKernel kernel)
+{
+    switch (kernel)
+    {
+#ifdef LINE_SCANNER_AVX2
+    case ScanKernel::AVX2:
+        return classifyAvx2(block);
+#endif
+#ifdef LINE_SCANNER_SSE2
+    case ScanKernel::SSE2:
+        return classifySse2(block);
+#endif
+    default:
+        return classifyScalar(block);
+    }
+}
+
+// Splits the lines of text starting at position into lines, at most
+// max_lines of them, and moves position past the last one. Returns the
+// number of lines, 0 at the end of the text.
+inline size_t tokenizeLines(string_view text, size_t &position, TokenizedLine *lines, size_t max_lines,
+                            ScanKernel kernel = activeScanKernel())
+{
+    size_t count = 0;
+    if (position >= text.size() || max_lines == 0)
+    {
+        return 0;
+    }
+
+    const char *data = text.data();
+    size_t line_start = position;
+    size_t token_start = 0;
+    bool in_token = false;
+    TokenizedLine *line = &lines[0];
+    line->count = 0;
+
+    // Closes the current line, which ends at end (a newline or the text end)
+    auto finishLine = [&](size_t end)
+    {
+        if (in_token)
+        {
+            if (line->count < MAX_LINE_TOKENS)
+            {
+                line->tokens[line->count++] = string_view(data + token_start, end - token_start);
+            }
+            in_token = false;
+        }
+
+        // A "\r" before the line end belongs to the line ending, not to the last token
+        size_t text_end = end;
+        if (text_end > line_start && data[text_end - 1] == '\r')
+        {
+            text_end--;
+            if (line->count > 0)
+            {
+                string_view &last = line->tokens[line->count - 1];
+                if (last.data() + last.size() == data + end)
+                {
+                    last.remove_suffix(1);
+                    line->count -= last.empty();
+                }
+            }
+        }
+        line->text = string_view(data + line_start, text_end - line_start);
+        for (int i = line->count; i < MAX_LINE_TOKENS; i++)
+        {
+            line->tokens[i] = string_view();
+        }
+    };
+
+    uint64_t previous_separator = 1; // a line start acts like a separator
+    char tail[64];
+    for (size_t base = position; base < text.size(); base += 64)
+    {
+        size_t length = text.size() - base;
+        const char *block = data + base;
+        uint64_t valid = ~uint64_t(0);
+        if (length < 64)
+        {
+            // Copy the last partial block so the kernels can read 64 bytes
+            memcpy(tail, block, length);
+            memset(tail + length, ' ', 64 - length);
+            block = tail;
+            valid = (uint64_t(1) << length) - 1;
+        }
+
+        ByteClasses classes = classifyBlock(block, kernel);
+        uint64_t separators = classes.separators & valid;
+        uint64_t edges = (separators ^ ((separators << 1) | previous_separator)) & valid;
+        uint64_t events = edges | (classes.newlines & valid);
+        previous_separator = separators >> 63;
+
+        while (events != 0)
+        {
+            int bit = lowestBit(events);
+            events &= events - 1;
+            size_t offset = base + bit;
+
+            if ((separators >> bit & 1) == 0)
+            {
+                token_start = offset;
+                in_token = true;
+                continue;
+            }
+            if (in_token)
+            {
+                if (line->count < MAX_LINE_TOKENS)
+                {
+                    line->tokens[line->count++] = string_view(data + token_start, offset - token_start);
+                }
+                in_token = false;
+            }
+            if (classes.newlines >> bit & 1)
+            {
+                finishLine(offset);
+                position = offset + 1;
+                if (++count == max_lines)
+                {
+                    return count;
+                }
+                line = &lines[count];
+                line->count = 0;
+                line_start = offset + 1;
+            }
+        }
+    }
+
+    // A last line without a newline
+    if (line_start < text.size())
+    {
+        finishLine(text.size());
+        count++;
+    }
+    position = text.size();
+    return count;
+}
+
+// Tokenizes a single line, for callers that already have one
+inline TokenizedLine tokenizeLine(string_view line)
+{
+    TokenizedLine tokenized;
+    tokenized.text = line;
+    size_t start = 0;
+    while (tokenized.count < MAX_LINE_TOKENS)
+    {
+        start = line.find_first_not_of(" ,", start);
+        if (start == string_view::npos)
+        {
+            break;
+        }
+        size_t end = line.find_first_of(" ,", start);
+        if (end == string_view::npos)
+        {
+            end = line.size();
+        }
+        tokenized.tokens[tokenized.count++] = line.substr(start, end - start);
+        start = end;
+    }
+    return tokenized;
+}
+
+// Hands out the lines of a text one at a time, tokenizing them in batches
+class LineScanner
+{
+private:
+    static const size_t BATCH_LINES = 256;
+
+    string_view text;
+    size_t position = 0;
+    vector<TokenizedLine> batch;
+    size_t next_line = 0;
+    size_t filled = 0;
+
+public:
+    explicit LineScanner(string_view text) : text(text), batch(BATCH_LINES) {}
+
+    // Returns the next line, nullptr at the end of the text
+    const TokenizedLine *next()
+    {
+        if (next_line == filled)
+        {
+            filled = tokenizeLines(text, position, batch.data(), batch.size());
+            next_line = 0;
+            if (filled == 0)
+            {
+                return nullptr;
+            }
+        }
+        return &batch[next_line++];
+    }
+};
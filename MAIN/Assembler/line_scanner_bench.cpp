@@ -0,0 +1,95 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <chrono>
+#include "line_scanner.h"
+#include "source_reader.h"
+#include "program_generator.h"
+
+using namespace std;
+
+// Tokenizer throughput on a generated source: nextLine() plus splitTokens()
+// per line against tokenizeLines() with each kernel this CPU supports. Every
+// run sums the token lengths so the work cannot be optimized away.
+//
+// Usage: line_scanner_bench [LINES]   (default 10000000, about 170 MB)
+
+size_t runPerLine(string_view text)
+{
+    size_t total = 0;
+    string_view line;
+    size_t position = 0;
+    while (nextLine(text, position, line))
+    {
+        string_view tokens[4];
+        int count = splitTokens(line, " ,", tokens, 4);
+        for (int i = 0; i < count; i++)
+        {
+            total += tokens[i].size();
+        }
+    }
+    return total;
+}
+
+size_t runScanner(string_view text, ScanKernel kernel)
+{
+    size_t total = 0;
+    vector<TokenizedLine> batch(256);
+    size_t position = 0;
+    size_t count;
+    while ((count = tokenizeLines(text, position, batch.data(), batch.size(), kernel)) > 0)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            for (int t = 0; t < batch[i].count; t++)
+            {
+                total += batch[i].tokens[t].size();
+            }
+        }
+    }
+    return total;
+}
+
+template <typename Run>
+void report(const char *name, string_view text, size_t expected, Run run)
+{
+    auto begin = chrono::steady_clock::now();
+    size_t total = run();
+    auto finish = chrono::steady_clock::now();
+    double ms = chrono::duration<double, milli>(finish - begin).count();
+
+    cout << left << setw(16) << name << setw(12) << fixed << setprecision(1) << ms
+         << setw(12) << text.size() / 1e3 / ms;
+    if (total != expected)
+    {
+        cout << "token bytes differ: " << total << " != " << expected;
+    }
+    cout << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t lines = argc > 1 ? stoull(argv[1]) : 10000000;
+
+    ProgramGenerator generator;
+    string source = generator.generate(lines);
+    cout << lines << " lines, " << source.size() / (1024 * 1024) << " MiB" << endl;
+
+    cout << left << setw(16) << "Tokenizer" << setw(12) << "Time (ms)" << setw(12) << "MB/s" << endl;
+    cout << string(40, '-') << endl;
+
+    size_t expected = runPerLine(source);
+    report("per line", source, expected, [&]() { return runPerLine(source); });
+
+    const pair<const char *, ScanKernel> kernels[] = {
+        {"scalar", ScanKernel::SCALAR}, {"sse2", ScanKernel::SSE2}, {"avx2", ScanKernel::AVX2}};
+    for (const auto &kernel : kernels)
+    {
+        if (scanKernelSupported(kernel.second))
+        {
+            report(kernel.first, source, expected, [&]() { return runScanner(source, kernel.second); });
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "string_pool.h"
+#include "stats.h"
+
+using namespace std;
+
+struct Literal
+{
+    string_view value; // interned in the table's StringPool
+    int address;
+};
+
+// Literal table split into pools. A pool holds the literals used since the
+// previous LTORG (or the program start) and is flushed at the next LTORG or
+// END, so a literal is only shared with uses in its own pool. A value is
+// interned once however many pools use it, and lookups go through one
+// open-addressing hash keyed by (pool, value id); entries keep their 1-based
+// insertion order for (L,n).
+class LiteralTable
+{
+private:
+    StringPool values;
+    vector<Literal> literals;
+    vector<uint32_t> value_ids;      // interned value of every literal
+    vector<uint32_t> literal_pools;  // pool of every literal
+    vector<size_t> pool_starts = {0}; // first literal of every pool, the last pool is open
+    vector<int> slots;                // 0 = empty, otherwise index into literals + 1
+    size_t mask = 0;
+
+    uint32_t hashLiteral(size_t pool, uint32_t value_id) const
+    {
+        // The value's own hash mixed with the pool number
+        uint32_t hash = values.hash(value_id) ^ (uint32_t)(pool * 0x9E3779B9u);
+        return hash ^ (hash >> 16);
+    }
+
+    void insertSlot(size_t index)
+    {
+        size_t slot = hashLiteral(literal_pools[index], value_ids[index]) & mask;
+        while (slots[slot] != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = index + 1;
+    }
+
+    void rehash(size_t capacity)
+    {
+        slots.assign(capacity, 0);
+        mask = capacity - 1;
+        for (size_t i = 0; i < literals.size(); i++)
+        {
+            insertSlot(i);
+        }
+    }
+
+public:
+    LiteralTable()
+    {
+        rehash(16);
+    }
+
+    LiteralTable(const LiteralTable &other)
+        : values(other.values), literals(other.literals), value_ids(other.value_ids),
+          literal_pools(other.literal_pools), pool_starts(other.pool_starts), slots(other.slots), mask(other.mask)
+    {
+        // Point the copied literals at this table's own arena
+        for (size_t i = 0; i < literals.size(); i++)
+        {
+            literals[i].value = values[value_ids[i]];
+        }
+    }
+
+    LiteralTable &operator=(const LiteralTable &other)
+    {
+        if (this != &other)
+        {
+            LiteralTable copy(other);
+            *this = move(copy);
+        }
+        return *this;
+    }
+
+    LiteralTable(LiteralTable &&) = default;
+    LiteralTable &operator=(LiteralTable &&) = default;
+
+    // Returns the 1-based index of value in the given pool, or 0
+    int find(size_t pool, string_view value) const
+    {
+        STATS_ADD(literal_lookups, 1);
+        uint32_t value_id = values.find(value);
+        if (value_id == 0)
+        {
+            return 0;
+        }
+
+        size_t slot = hashLiteral(pool, value_id) & mask;
+        while (slots[slot] != 0)
+        {
+            STATS_ADD(literal_probes, 1);
+            int index = slots[slot] - 1;
+            if (literal_pools[index] == pool && value_ids[index] == value_id)
+            {
+                return index + 1;
+            }
+            slot = (slot + 1) & mask;
+        }
+        return 0;
+    }
+
+    // Appends value to the open pool and returns its 1-based index
+    int add(string_view value)
+    {
+        uint32_t value_id = values.intern(value);
+        literals.push_back({values[value_id], -1});
+        value_ids.push_back(value_id);
+        literal_pools.push_back(openPool());
+
+        // Keep the load factor at or below one half
+        if (literals.size() * 2 > slots.size())
+        {
+            rehash(slots.size() * 2);
+        }
+        else
+        {
+            insertSlot(literals.size() - 1);
+        }
+        return literals.size();
+    }
+
+    // Ends the open pool; later literals go into a new one
+    void closePool()
+    {
+        pool_starts.push_back(literals.size());
+    }
+
+    size_t openPool() const { return pool_starts.size() - 1; }
+    size_t poolCount() const { return pool_starts.size(); }
+
+    // 0-based [first, last) range of the literals in a pool
+    pair<size_t, size_t> poolRange(size_t pool) const
+    {
+        size_t last = pool + 1 < pool_starts.size() ? pool_starts[pool + 1] : literals.size();
+        return {pool_starts[pool], last};
+    }
+
+    void clear()
+    {
+        values.clear();
+        literals.clear();
+        value_ids.clear();
+        literal_pools.clear();
+        pool_starts.assign(1, 0);
+        rehash(16);
+    }
+
+    size_t size() const { return literals.size(); }
+    bool empty() const { return literals.empty(); }
+
+    Literal &operator[](size_t i) { return literals[i]; }
+    const Literal &operator[](size_t i) const { return literals[i]; }
+
+    vector<Literal>::const_iterator begin() const { return literals.begin(); }
+    vector<Literal>::const_iterator end() const { return literals.end(); }
+};
@@ -0,0 +1,129 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include "assembler.h"
+
+using namespace std;
+
+// Literal pool scaling benchmark.
+// Builds a source with n distinct literals split into pools of 32, each
+// literal used twice before the LTORG that flushes its pool, and assembles
+// it. The linear column replays the same literal traffic against a plain
+// vector searched with find_if, as the assembler did before.
+
+const int POOL_SIZE = 32;
+
+string makeSource(int n)
+{
+    string source = "START 100\n";
+    for (int first = 0; first < n; first += POOL_SIZE)
+    {
+        int last = min(n, first + POOL_SIZE);
+        for (int round = 0; round < 2; round++)
+        {
+            for (int i = first; i < last; i++)
+            {
+                source += "ADD AREG, ='" + to_string(i) + "'\n";
+            }
+        }
+        source += "LTORG\n";
+    }
+    source += "END\n";
+    return source;
+}
+
+double runAssembler(const string &source, int n)
+{
+    auto begin = chrono::steady_clock::now();
+    ObjectModule module = assemble(source);
+    auto finish = chrono::steady_clock::now();
+
+    if ((int)module.literal_table.size() != n)
+    {
+        cerr << "unexpected literal count " << module.literal_table.size() << endl;
+    }
+    return chrono::duration<double, milli>(finish - begin).count();
+}
+
+double runLinear(int n)
+{
+    vector<string> values;
+    for (int i = 0; i < n; i++)
+    {
+        values.push_back("='" + to_string(i) + "'");
+    }
+
+    auto begin = chrono::steady_clock::now();
+
+    vector<Literal> literal_table;
+    long checksum = 0;
+
+    // Pass 1 enters the literals, pass 2 looks up every use
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int first = 0; first < n; first += POOL_SIZE)
+        {
+            int last = min(n, first + POOL_SIZE);
+            for (int round = 0; round < 2; round++)
+            {
+                for (int i = first; i < last; i++)
+                {
+                    auto it = find_if(literal_table.begin(), literal_table.end(),
+                                      [&](const Literal &l)
+                                      { return l.value == values[i]; });
+                    if (it == literal_table.end())
+                    {
+                        literal_table.push_back({values[i], -1});
+                        it = literal_table.end() - 1;
+                    }
+                    checksum += distance(literal_table.begin(), it);
+                }
+            }
+        }
+    }
+
+    auto finish = chrono::steady_clock::now();
+    if (checksum == 0)
+    {
+        cerr << "unexpected checksum" << endl;
+    }
+    return chrono::duration<double, milli>(finish - begin).count();
+}
+
+int main()
+{
+    const int sizes[] = {1000, 4000, 16000, 64000, 256000};
+    const int linear_limit = 16000; // the linear scan is quadratic, stop it early
+
+    cout << left << setw(12) << "Literals"
+         << setw(10) << "Pools"
+         << setw(18) << "Assemble (ms)"
+         << setw(16) << "ns/literal"
+         << setw(16) << "Linear (ms)" << endl;
+    cout << string(72, '-') << endl;
+
+    for (int n : sizes)
+    {
+        string source = makeSource(n);
+        double assembled = runAssembler(source, n);
+
+        cout << left << setw(12) << n
+             << setw(10) << (n + POOL_SIZE - 1) / POOL_SIZE
+             << setw(18) << fixed << setprecision(2) << assembled
+             << setw(16) << assembled * 1e6 / n;
+        if (n <= linear_limit)
+        {
+            cout << setw(16) << runLinear(n);
+        }
+        else
+        {
+            cout << setw(16) << "-";
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
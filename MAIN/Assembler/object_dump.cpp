@@ -0,0 +1,93 @@
+#include <iostream>
+#include <string>
+#include "object_file.h"
+
+using namespace std;
+
+// Usage: object_dump file.obj
+// Prints the sections of an object file written with --object
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        cerr << "Usage: object_dump file.obj" << endl;
+        return 1;
+    }
+
+    ObjectFile object;
+    if (!object.open(argv[1]))
+    {
+        cerr << "Error: " << argv[1] << " is not a valid object file!" << endl;
+        return 1;
+    }
+
+    OutputWriter out;
+
+    out.write("Symbols:\n");
+    for (const auto &symbol : object.symbols())
+    {
+        out.column(object.name(symbol.name_offset, symbol.name_length), 15);
+        out.writeInt(symbol.address);
+        out.newline();
+    }
+
+    out.write("\nLiterals:\n");
+    for (const auto &literal : object.literals())
+    {
+        out.column(object.name(literal.name_offset, literal.name_length), 15);
+        out.writeInt(literal.address);
+        out.newline();
+    }
+
+    out.write("\nPools:\n");
+    for (uint32_t start : object.pools())
+    {
+        out.writeInt(start);
+        out.newline();
+    }
+
+    auto links = object.links();
+    out.write("\nLinks:\n");
+    for (const auto &link : links)
+    {
+        out.column(object.name(link.name_offset, link.name_length), 15);
+        out.column(link.type == (uint32_t)LinkType::EXTERN ? "EXTERN" : "ENTRY", 10);
+        out.writeInt(link.address);
+        out.newline();
+    }
+
+    out.write("\nRelocations:\n");
+    for (const auto &relocation : object.relocations())
+    {
+        out.column(relocation.word, 8);
+        if (relocation.link == 0)
+        {
+            out.write("local");
+        }
+        else if (relocation.link <= links.size())
+        {
+            const LinkEntry &link = links[relocation.link - 1];
+            out.write(object.name(link.name_offset, link.name_length));
+        }
+        out.newline();
+    }
+
+    // Operands are resolved, so S and L give an address, not a table index
+    const char *kind_names[] = {"", "R", "S", "L", "C"};
+    out.write("\nCode:\n");
+    for (const auto &word : object.code())
+    {
+        out.column(word.lc, 8);
+        out.column(opClassName((OpClass)word.op_class), 4);
+        out.column(word.opcode, 4);
+        out.column(word.reg, 4);
+        if (word.kind != (uint8_t)OperandKind::NONE && word.kind < size(kind_names))
+        {
+            out.column(kind_names[word.kind], 3);
+            out.writeInt(word.operand);
+        }
+        out.newline();
+    }
+
+    return 0;
+}
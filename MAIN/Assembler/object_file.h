@@ -0,0 +1,376 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "assembler.h"
+#include "source_reader.h"
+#include "output_writer.h"
+
+using namespace std;
+
+// Binary object file. Every field is a 32-bit (or smaller) little-endian
+// value at its natural alignment, so a loader can map the file and use the
+// sections in place:
+//
+//   ObjectHeader
+//   SectionHeader[section_count]
+//   sections, each starting on an 8-byte boundary
+//
+// Names live in the STRINGS section and are referred to by offset and length.
+// A reader skips section types it does not know; the version changes only
+// when an existing layout changes (2: CODE holds resolved intermediate code
+// records instead of listing rows).
+
+const uint32_t OBJECT_MAGIC = 0x4A424F41; // "AOBJ"
+const uint32_t OBJECT_VERSION = 2;
+
+enum class SectionType : uint32_t
+{
+    CODE = 1,    // CodeWord per intermediate code record
+    SYMBOLS,     // NamedAddress per symbol table entry
+    LITERALS,    // NamedAddress per literal
+    POOLS,       // uint32_t 1-based start of every literal pool
+    RELOCATIONS, // RelocationRecord per operand that holds an address
+    LINKS,       // LinkEntry per EXTERN/ENTRY directive
+    STRINGS,     // name bytes
+
+    // Only in incremental assembly caches
+    INTERMEDIATE = 16, // ICRecord per intermediate code record
+    LITERAL_POOLS,     // uint32_t first literal of every pool, empty ones included
+    SOURCE_LINES,      // LineState per source line, see incremental.h
+    SYMBOL_ADDRESSES,  // int32_t per symbol, only in the patches of a cache
+    LITERAL_ADDRESSES  // int32_t per literal, only in the patches of a cache
+};
+
+struct ObjectHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t section_count;
+    uint32_t reserved;
+};
+
+struct SectionHeader
+{
+    uint32_t type;
+    uint32_t offset; // from the start of the file
+    uint32_t size;   // in bytes
+    uint32_t count;  // of entries
+};
+
+// An intermediate code record with its operand resolved, so a loader needs
+// no symbol or literal lookups: the address of a SYMBOL (a jump's target
+// too, -1 for an EXTERN) or LITERAL operand, a register code, or for
+// CONSTANT the START/ORIGIN address, the DC value or the DS size
+struct CodeWord
+{
+    int32_t lc;
+    uint8_t op_class; // OpClass
+    uint8_t opcode;
+    uint8_t reg;  // register of an (R,n) first operand, 0 if there is none
+    uint8_t kind; // OperandKind of operand
+    int32_t operand;
+};
+
+struct NamedAddress
+{
+    uint32_t name_offset;
+    uint32_t name_length;
+    int32_t address;
+};
+
+// The operand of CODE[word] is an address. link is 0 when it is an address in
+// this module, otherwise the 1-based LINKS entry of the EXTERN it refers to.
+struct RelocationRecord
+{
+    uint32_t word;
+    uint32_t link;
+};
+
+struct LinkEntry
+{
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint32_t type;   // LinkType
+    int32_t address; // of an ENTRY symbol, -1 for EXTERN
+};
+
+static_assert(sizeof(ObjectHeader) == 16 && sizeof(SectionHeader) == 16 &&
+                  sizeof(CodeWord) == 12 && sizeof(NamedAddress) == 12 &&
+                  sizeof(RelocationRecord) == 8 && sizeof(LinkEntry) == 16,
+              "Object file records must not be padded");
+
+// Whether bytes start with the object file magic, to tell an object file
+// from a source
+inline bool hasObjectMagic(string_view bytes)
+{
+    return bytes.size() >= sizeof(OBJECT_MAGIC) && memcmp(bytes.data(), &OBJECT_MAGIC, sizeof(OBJECT_MAGIC)) == 0;
+}
+
+inline bool isLittleEndian()
+{
+    uint16_t probe = 1;
+    unsigned char first;
+    memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// Code word of an intermediate code record, its operand resolved in the tables
+inline CodeWord codeWord(const ICRecord &ic, const SymbolTable &symbols, const LiteralTable &literals)
+{
+    CodeWord word = {ic.lc, (uint8_t)ic.op_class, ic.opcode, ic.reg, (uint8_t)ic.kind, 0};
+    if (ic.kind == OperandKind::SYMBOL && ic.value >= 1 && (size_t)ic.value <= symbols.size())
+    {
+        word.operand = symbols[ic.value - 1].second;
+    }
+    else if (ic.kind == OperandKind::LITERAL && ic.value >= 1 && (size_t)ic.value <= literals.size())
+    {
+        word.operand = literals[ic.value - 1].address;
+    }
+    else if (ic.kind == OperandKind::REGISTER || ic.kind == OperandKind::CONSTANT)
+    {
+        word.operand = ic.value;
+    }
+    else
+    {
+        word.kind = (uint8_t)OperandKind::NONE;
+    }
+    return word;
+}
+
+// CODE section of a module, one word per intermediate code record
+inline vector<CodeWord> objectCode(const ObjectModule &module)
+{
+    vector<CodeWord> code;
+    code.reserve(module.intermediate_code.size());
+    for (const auto &ic : module.intermediate_code)
+    {
+        code.push_back(codeWord(ic, module.symbol_table, module.literal_table));
+    }
+    return code;
+}
+
+// Raw section contents for writeObjectFile
+struct ObjectSection
+{
+    SectionType type;
+    const void *data;
+    size_t size;  // in bytes
+    size_t count; // of entries
+};
+
+// Writes module to filename, followed by any extra sections. Returns false if
+// the file could not be written.
+inline bool writeObjectFile(const ObjectModule &module, const string &filename,
+                            const vector<ObjectSection> &extra = {})
+{
+    if (!isLittleEndian())
+    {
+        return false;
+    }
+
+    string strings;
+    auto addString = [&strings](string_view name)
+    {
+        uint32_t offset = strings.size();
+        strings += name;
+        return offset;
+    };
+
+    vector<CodeWord> code = objectCode(module);
+
+    vector<NamedAddress> symbols;
+    for (const auto &entry : module.symbol_table)
+    {
+        symbols.push_back({addString(entry.first), (uint32_t)entry.first.size(), entry.second});
+    }
+
+    vector<NamedAddress> literals;
+    for (const auto &literal : module.literal_table)
+    {
+        literals.push_back({addString(literal.value), (uint32_t)literal.value.size(), literal.address});
+    }
+
+    vector<uint32_t> pools(module.pool_table.begin(), module.pool_table.end());
+
+    vector<LinkEntry> links;
+    vector<uint32_t> extern_links(module.symbol_table.size() + 1, 0); // per symbol
+    for (const auto &record : module.link_records)
+    {
+        int symbol_index = module.symbol_table.find(record.name);
+        int address = -1;
+        if (record.type == LinkType::EXTERN && symbol_index != 0)
+        {
+            extern_links[symbol_index] = links.size() + 1;
+        }
+        else if (symbol_index != 0)
+        {
+            address = module.symbol_table[symbol_index - 1].second;
+        }
+        links.push_back({addString(record.name), (uint32_t)record.name.size(), (uint32_t)record.type, address});
+    }
+
+    // Every symbol and literal operand is an address, a jump's target included
+    vector<RelocationRecord> relocations;
+    for (size_t i = 0; i < code.size(); i++)
+    {
+        if (code[i].kind == (uint8_t)OperandKind::SYMBOL)
+        {
+            relocations.push_back({(uint32_t)i, extern_links[module.intermediate_code[i].value]});
+        }
+        else if (code[i].kind == (uint8_t)OperandKind::LITERAL)
+        {
+            relocations.push_back({(uint32_t)i, 0});
+        }
+    }
+
+    vector<ObjectSection> sections = {
+        {SectionType::CODE, code.data(), code.size() * sizeof(CodeWord), code.size()},
+        {SectionType::SYMBOLS, symbols.data(), symbols.size() * sizeof(NamedAddress), symbols.size()},
+        {SectionType::LITERALS, literals.data(), literals.size() * sizeof(NamedAddress), literals.size()},
+        {SectionType::POOLS, pools.data(), pools.size() * sizeof(uint32_t), pools.size()},
+        {SectionType::RELOCATIONS, relocations.data(), relocations.size() * sizeof(RelocationRecord), relocations.size()},
+        {SectionType::LINKS, links.data(), links.size() * sizeof(LinkEntry), links.size()},
+        {SectionType::STRINGS, strings.data(), strings.size(), strings.size()}};
+    sections.insert(sections.end(), extra.begin(), extra.end());
+    const uint32_t section_count = sections.size();
+
+    ObjectHeader header = {OBJECT_MAGIC, OBJECT_VERSION, section_count, 0};
+    vector<SectionHeader> directory;
+    size_t offset = sizeof(ObjectHeader) + section_count * sizeof(SectionHeader);
+    for (const auto &section : sections)
+    {
+        directory.push_back({(uint32_t)section.type, (uint32_t)offset, (uint32_t)section.size, (uint32_t)section.count});
+        offset += (section.size + 7) & ~size_t(7);
+    }
+
+    OutputWriter out(filename);
+    out.write(string_view((const char *)&header, sizeof(header)));
+    out.write(string_view((const char *)directory.data(), directory.size() * sizeof(SectionHeader)));
+    for (const auto &section : sections)
+    {
+        out.write(string_view((const char *)section.data, section.size));
+        out.fill('\0', ((section.size + 7) & ~size_t(7)) - section.size);
+    }
+    return out.flush();
+}
+
+// Entries of one section, used in place
+template <typename T>
+struct SectionView
+{
+    const T *data = nullptr;
+    size_t count = 0;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T &operator[](size_t i) const { return data[i]; }
+    const T *begin() const { return data; }
+    const T *end() const { return data + count; }
+};
+
+// Object file mapped into memory. The sections are checked against the file
+// size when it is opened and are read straight out of the mapping.
+class ObjectFile
+{
+private:
+    SourceReader file;
+    string_view bytes;
+    const SectionHeader *directory = nullptr;
+    uint32_t section_count = 0;
+    size_t sections_end = 0; // first byte after the last section's padding
+
+public:
+    bool open(const string &filename)
+    {
+        if (!isLittleEndian() || !file.open(filename))
+        {
+            return false;
+        }
+        bytes = file.text();
+
+        if (bytes.size() < sizeof(ObjectHeader) || (uintptr_t)bytes.data() % alignof(ObjectHeader) != 0)
+        {
+            return false;
+        }
+        const ObjectHeader *header = (const ObjectHeader *)bytes.data();
+        if (header->magic != OBJECT_MAGIC || header->version != OBJECT_VERSION ||
+            header->section_count > (bytes.size() - sizeof(ObjectHeader)) / sizeof(SectionHeader))
+        {
+            return false;
+        }
+
+        directory = (const SectionHeader *)(bytes.data() + sizeof(ObjectHeader));
+        section_count = header->section_count;
+        for (uint32_t i = 0; i < section_count; i++)
+        {
+            const SectionHeader &section = directory[i];
+            if (section.offset % 4 != 0 || section.offset > bytes.size() ||
+                section.size > bytes.size() - section.offset)
+            {
+                return false;
+            }
+            sections_end = max<size_t>(sections_end, section.offset + ((section.size + size_t(7)) & ~size_t(7)));
+        }
+        sections_end = min(max(sections_end, sizeof(ObjectHeader) + section_count * sizeof(SectionHeader)), bytes.size());
+        return true;
+    }
+
+    // Entries of a section, empty if the file has no such section or its
+    // size or alignment does not fit the entry type
+    template <typename T>
+    SectionView<T> section(SectionType type) const
+    {
+        for (uint32_t i = 0; i < section_count; i++)
+        {
+            const SectionHeader &header = directory[i];
+            if (header.type == (uint32_t)type)
+            {
+                if (header.size != (uint64_t)header.count * sizeof(T) || header.offset % alignof(T) != 0)
+                {
+                    return {};
+                }
+                return {(const T *)(bytes.data() + header.offset), header.count};
+            }
+        }
+        return {};
+    }
+
+    SectionView<CodeWord> code() const { return section<CodeWord>(SectionType::CODE); }
+    SectionView<NamedAddress> symbols() const { return section<NamedAddress>(SectionType::SYMBOLS); }
+    SectionView<NamedAddress> literals() const { return section<NamedAddress>(SectionType::LITERALS); }
+    SectionView<uint32_t> pools() const { return section<uint32_t>(SectionType::POOLS); }
+    SectionView<RelocationRecord> relocations() const { return section<RelocationRecord>(SectionType::RELOCATIONS); }
+    SectionView<LinkEntry> links() const { return section<LinkEntry>(SectionType::LINKS); }
+
+    size_t size() const { return bytes.size(); }
+
+    // Bytes after the last section, which writeObjectFile() never writes; an
+    // incremental cache keeps its patches there
+    string_view trailer() const { return bytes.substr(sections_end); }
+
+    // The SYMBOLS section as a table, for looking symbols up by name
+    SymbolTable symbolTable() const
+    {
+        SymbolTable table;
+        for (const auto &symbol : symbols())
+        {
+            table.add(name(symbol.name_offset, symbol.name_length), symbol.address);
+        }
+        return table;
+    }
+
+    // Name stored at offset in the STRINGS section, empty if out of range
+    string_view name(uint32_t offset, uint32_t length) const
+    {
+        SectionView<char> strings = section<char>(SectionType::STRINGS);
+        if (offset > strings.size() || length > strings.size() - offset)
+        {
+            return string_view();
+        }
+        return string_view(strings.data + offset, length);
+    }
+};
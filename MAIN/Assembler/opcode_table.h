@@ -0,0 +1,146 @@
+#pragma once
+
+#include <string_view>
+#include <cstdint>
+#include "intermediate_code.h"
+
+using namespace std;
+
+// Compact description of a mnemonic: its class and its opcode within the class
+struct OpcodeInfo
+{
+    OpClass op_class = OpClass::IS;
+    uint8_t opcode = 0;
+};
+
+template <typename Value>
+struct TableEntry
+{
+    string_view key;
+    Value value = {};
+};
+
+constexpr uint32_t seededHash(string_view key, uint32_t seed)
+{
+    // FNV-1a started from a per-table seed, with a final mix of the high bits
+    uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (char c : key)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+// Fixed lookup table built at compile time. The constructor searches for a
+// seed under which every key lands in its own slot, so a lookup is one hash,
+// one slot and one compare.
+template <typename Value, size_t Size>
+class PerfectHashTable
+{
+    static_assert((Size & (Size - 1)) == 0, "Size must be a power of two");
+
+private:
+    TableEntry<Value> slots[Size] = {};
+    uint32_t seed = 0;
+
+public:
+    template <size_t N>
+    constexpr PerfectHashTable(const TableEntry<Value> (&entries)[N])
+    {
+        static_assert(N <= Size / 2, "Table is too small for the entries");
+
+        for (uint32_t candidate = 1; candidate < 100000 && seed == 0; candidate++)
+        {
+            bool used[Size] = {};
+            bool collision = false;
+            for (size_t i = 0; i < N && !collision; i++)
+            {
+                size_t slot = seededHash(entries[i].key, candidate) & (Size - 1);
+                collision = used[slot];
+                used[slot] = true;
+            }
+            if (!collision)
+            {
+                seed = candidate;
+            }
+        }
+
+        for (size_t i = 0; i < N; i++)
+        {
+            slots[seededHash(entries[i].key, seed) & (Size - 1)] = entries[i];
+        }
+    }
+
+    // Returns the value stored for key, or nullptr if key is not in the table
+    constexpr const Value *find(string_view key) const
+    {
+        const TableEntry<Value> &slot = slots[seededHash(key, seed) & (Size - 1)];
+        if (!key.empty() && slot.key == key)
+        {
+            return &slot.value;
+        }
+        return nullptr;
+    }
+
+    constexpr bool valid() const { return seed != 0; }
+};
+
+constexpr TableEntry<OpcodeInfo> ASSEMBLER_OPCODES[] = {
+    {"START", {OpClass::AD, 1}},
+    {"END", {OpClass::AD, 2}},
+    {"ORIGIN", {OpClass::AD, 3}},
+    {"LTORG", {OpClass::AD, 4}},
+    {"EXTERN", {OpClass::AD, 5}},
+    {"ENTRY", {OpClass::AD, 6}},
+    {"MOVER", {OpClass::IS, 1}},
+    {"ADD", {OpClass::IS, 2}},
+    {"SUB", {OpClass::IS, 3}},
+    {"STOP", {OpClass::IS, 4}},
+    {"COMP", {OpClass::IS, 5}},
+    {"JZ", {OpClass::IS, 6}},
+    {"JMP", {OpClass::IS, 7}},
+    {"JNZ", {OpClass::IS, 8}},
+    {"INCR", {OpClass::IS, 9}},
+    {"DECR", {OpClass::IS, 10}},
+    {"MULT", {OpClass::IS, 11}},
+    {"DIV", {OpClass::IS, 12}},
+    {"DC", {OpClass::DL, 1}},
+    {"DS", {OpClass::DL, 2}}};
+
+// MOT of the linking assembler in project2.cpp, which uses opcode 11 for
+// STORE and has no MULT/DIV
+constexpr TableEntry<OpcodeInfo> LINKER_OPCODES[] = {
+    {"START", {OpClass::AD, 1}},
+    {"END", {OpClass::AD, 2}},
+    {"ORIGIN", {OpClass::AD, 3}},
+    {"LTORG", {OpClass::AD, 4}},
+    {"EXTERN", {OpClass::AD, 5}},
+    {"ENTRY", {OpClass::AD, 6}},
+    {"MOVER", {OpClass::IS, 1}},
+    {"ADD", {OpClass::IS, 2}},
+    {"SUB", {OpClass::IS, 3}},
+    {"STOP", {OpClass::IS, 4}},
+    {"COMP", {OpClass::IS, 5}},
+    {"JZ", {OpClass::IS, 6}},
+    {"JMP", {OpClass::IS, 7}},
+    {"JNZ", {OpClass::IS, 8}},
+    {"INCR", {OpClass::IS, 9}},
+    {"DECR", {OpClass::IS, 10}},
+    {"STORE", {OpClass::IS, 11}},
+    {"DC", {OpClass::DL, 1}},
+    {"DS", {OpClass::DL, 2}}};
+
+constexpr TableEntry<int> REGISTERS[] = {
+    {"AREG", 1},
+    {"BREG", 2},
+    {"CREG", 3},
+    {"DREG", 4}};
+
+constexpr PerfectHashTable<OpcodeInfo, 64> assembler_mot(ASSEMBLER_OPCODES);
+constexpr PerfectHashTable<OpcodeInfo, 64> linker_mot(LINKER_OPCODES);
+constexpr PerfectHashTable<int, 8> register_table(REGISTERS);
+
+static_assert(assembler_mot.valid() && linker_mot.valid() && register_table.valid(),
+              "No perfect hash seed found");
+static_assert(assembler_mot.find("MOVER")->opcode == 1 && assembler_mot.find("MOV") == nullptr);
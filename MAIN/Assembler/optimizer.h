@@ -0,0 +1,726 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include "intermediate_code.h"
+#include "symbol_table.h"
+#include "literal_pool.h"
+#include "source_reader.h"
+
+using namespace std;
+
+// Opcodes the optimizer looks at, as numbered in ASSEMBLER_OPCODES
+namespace Opcode
+{
+    // IS
+    const uint8_t MOVER = 1, ADD = 2, SUB = 3, STOP = 4, COMP = 5, JZ = 6, JMP = 7, JNZ = 8,
+                  INCR = 9, DECR = 10, MULT = 11, DIV = 12;
+    // AD
+    const uint8_t START = 1, END = 2, ORIGIN = 3, LTORG = 4;
+    // DL
+    const uint8_t DC = 1, DS = 2;
+}
+
+// Instructions dropped by one rule
+struct RuleCount
+{
+    const char *rule;
+    size_t removed;
+};
+
+struct OptimizerReport
+{
+    vector<RuleCount> rules;
+    size_t removed = 0;  // instructions
+    size_t words = 0;    // words of code saved
+    size_t threaded = 0; // jumps sent to the end of their jump chain
+};
+
+// Optimizer over the intermediate code of a two-pass run, between pass 2 and
+// machine code generation. Its stages (jump threading, dead code removal and
+// the peephole rules) mark records as removed, then the program is laid out
+// again: a record moves up by the words removed before it (up to the next
+// START/ORIGIN, which fix the LC), labels move with the record they point at
+// and every literal pool moves with its LTORG/END.
+//
+// The stages assume the machine model of the simulator: execution goes on at
+// the first instruction at or after an address (LC + 2, or a jump's target),
+// so declarations in the way are skipped, and stops at STOP or when no
+// instruction follows. MOVER loads a register, only COMP sets the condition
+// that JZ/JNZ test, no instruction writes memory, and a memory operand that
+// falls on an instruction reads 0. A record that a memory operand points
+// into is never removed, so every read finds the same word afterwards. A
+// program that reads outside its own words is only kept equal up to that
+// read: removing a load can also remove the fault.
+class Optimizer
+{
+public:
+    // A peephole rule looks at width adjacent IS records, given as record
+    // indices, and returns the ones to drop as a bit mask (bit 0 for the
+    // first), or 0 if it does not apply
+    struct PeepholeRule
+    {
+        const char *name;
+        int width;
+        uint32_t (*apply)(const Optimizer &optimizer, const size_t *window);
+    };
+
+private:
+    vector<ICRecord> &intermediate_code;
+    SymbolTable &symbol_table;
+    LiteralTable &literal_table;
+    OptimizerReport summary;
+
+    vector<bool> removed;              // per record
+    vector<bool> target;               // a label points at the record
+    vector<bool> pinned;               // a memory operand points into the record
+    vector<pair<int, size_t>> by_lc;   // (LC, record) of every record, sorted
+    vector<pair<int, size_t>> code;    // the same for IS records only
+
+    static const uint32_t DROP_FIRST = 1, DROP_BOTH = 3;
+
+    static bool isLoad(const ICRecord &ic)
+    {
+        return ic.opcode == Opcode::MOVER && ic.reg != 0 &&
+               (ic.kind == OperandKind::SYMBOL || ic.kind == OperandKind::LITERAL || ic.kind == OperandKind::REGISTER);
+    }
+
+    // The peephole rules, tried in order at every position
+    static const vector<PeepholeRule> &peepholeRules()
+    {
+        static const vector<PeepholeRule> rules = {
+            // MOVER r, r
+            {"self-move", 1, [](const Optimizer &o, const size_t *w) -> uint32_t
+             {
+                 const ICRecord &a = o.record(w[0]);
+                 return a.opcode == Opcode::MOVER && a.reg != 0 && a.kind == OperandKind::REGISTER && a.value == a.reg;
+             }},
+            // ADD/SUB r, ='0'
+            {"add-zero", 1, [](const Optimizer &o, const size_t *w) -> uint32_t
+             {
+                 const ICRecord &a = o.record(w[0]);
+                 int value;
+                 return (a.opcode == Opcode::ADD || a.opcode == Opcode::SUB) && a.reg != 0 &&
+                        o.literalConstant(a, value) && value == 0;
+             }},
+            // MULT/DIV r, ='1'
+            {"multiply-one", 1, [](const Optimizer &o, const size_t *w) -> uint32_t
+             {
+                 const ICRecord &a = o.record(w[0]);
+                 int value;
+                 return (a.opcode == Opcode::MULT || a.opcode == Opcode::DIV) && a.reg != 0 &&
+                        o.literalConstant(a, value) && value == 1;
+             }},
+            // JMP/JZ/JNZ to the next instruction
+            {"jump-next", 1, [](const Optimizer &o, const size_t *w) -> uint32_t
+             {
+                 return o.jumpsToNext(w[0]);
+             }},
+            // INCR r; DECR r and DECR r; INCR r
+            {"increment-decrement", 2, [](const Optimizer &o, const size_t *w) -> uint32_t
+             {
+                 const ICRecord &a = o.record(w[0]), &b = o.record(w[1]);
+                 bool pair = (a.opcode == Opcode::INCR && b.opcode == Opcode::DECR) ||
+                             (a.opcode == Opcode::DECR && b.opcode == Opcode::INCR);
+                 return pair && a.reg != 0 && a.reg == b.reg && a.kind == OperandKind::NONE &&
+                                b.kind == OperandKind::NONE && !o.isTarget(w[1])
+                            ? DROP_BOTH
+                            : 0;
+             }},
+            // MOVER r, X; MOVER r, Y: the first load is overwritten, this
+            // also drops a repeated MOVER r, X
+            {"dead-load", 2, [](const Optimizer &o, const size_t *w) -> uint32_t
+             {
+                 const ICRecord &a = o.record(w[0]), &b = o.record(w[1]);
+                 bool reads_register = b.kind == OperandKind::REGISTER && b.value == b.reg;
+                 return isLoad(a) && isLoad(b) && a.reg == b.reg && !reads_register ? DROP_FIRST : 0;
+             }},
+            // COMP; COMP: the first condition is never tested
+            {"dead-compare", 2, [](const Optimizer &o, const size_t *w) -> uint32_t
+             {
+                 return o.record(w[0]).opcode == Opcode::COMP && o.record(w[1]).opcode == Opcode::COMP ? DROP_FIRST : 0;
+             }}};
+        return rules;
+    }
+
+    void count(const char *rule, size_t instructions)
+    {
+        for (auto &entry : summary.rules)
+        {
+            if (entry.rule == rule)
+            {
+                entry.removed += instructions;
+                return;
+            }
+        }
+        summary.rules.push_back({rule, instructions});
+    }
+
+    void sortByLc()
+    {
+        by_lc.clear();
+        by_lc.reserve(intermediate_code.size());
+        for (size_t i = 0; i < intermediate_code.size(); i++)
+        {
+            by_lc.push_back({intermediate_code[i].lc, i});
+        }
+        sort(by_lc.begin(), by_lc.end());
+
+        code.clear();
+        for (const auto &entry : by_lc)
+        {
+            if (intermediate_code[entry.second].op_class == OpClass::IS)
+            {
+                code.push_back(entry);
+            }
+        }
+    }
+
+    // [first, last) range of by_lc holding the records at the highest LC not
+    // above address, empty if the address is below every record
+    pair<size_t, size_t> recordsAt(int address) const
+    {
+        auto after = upper_bound(by_lc.begin(), by_lc.end(), make_pair(address, SIZE_MAX));
+        if (after == by_lc.begin())
+        {
+            return {0, 0};
+        }
+        int lc = prev(after)->first;
+        auto first = lower_bound(by_lc.begin(), by_lc.end(), make_pair(lc, size_t(0)));
+        return {first - by_lc.begin(), after - by_lc.begin()};
+    }
+
+    // The record an address lies in: the last one at the highest LC not above
+    // it, as directives that take no words come before the record they share
+    // an LC with; SIZE_MAX if the address is below every record. Symbols from
+    // pass 1 do not always fall on a record's LC, as pass 1 counts LTORG and
+    // ORIGIN as one word.
+    size_t recordAt(int address) const
+    {
+        auto range = recordsAt(address);
+        return range.first < range.second ? by_lc[range.second - 1].second : SIZE_MAX;
+    }
+
+    // The instruction execution goes on at from address: the first IS record
+    // at or after it, SIZE_MAX if there is none
+    size_t instructionFrom(int address) const
+    {
+        auto next = lower_bound(code.begin(), code.end(), make_pair(address, size_t(0)));
+        return next != code.end() ? next->second : SIZE_MAX;
+    }
+
+    // Words a record takes; directives take none, their literals belong to the pool
+    static int words(const ICRecord &ic)
+    {
+        switch (ic.op_class)
+        {
+        case OpClass::IS:
+            return 2;
+        case OpClass::DL:
+            return ic.opcode == Opcode::DS ? max(ic.value, 0) : 1;
+        default:
+            return 0;
+        }
+    }
+
+    static bool isJump(const ICRecord &ic)
+    {
+        return ic.op_class == OpClass::IS &&
+               (ic.opcode == Opcode::JMP || ic.opcode == Opcode::JZ || ic.opcode == Opcode::JNZ);
+    }
+
+    void drop(size_t i, const char *rule)
+    {
+        removed[i] = true;
+        count(rule, 1);
+        summary.removed++;
+        summary.words += words(intermediate_code[i]);
+    }
+
+    // Address a memory operand reads, -1 if the record has none
+    int dataAddress(const ICRecord &ic) const
+    {
+        bool memory = ic.op_class == OpClass::IS && ic.reg != 0 && !isJump(ic) && ic.kind == OperandKind::SYMBOL &&
+                      ic.value >= 1 && (size_t)ic.value <= symbol_table.size();
+        return memory ? symbol_table[ic.value - 1].second : -1;
+    }
+
+    // False if a record that takes words lies below the end of one before it
+    // in the source: a second START or an ORIGIN back. Records can then share
+    // words, of which the loader keeps the last one written, and pass 1
+    // symbols can point where pass 2 put no record.
+    bool laidOutInOrder() const
+    {
+        int end = INT_MIN; // first word after the records so far
+        for (const auto &ic : intermediate_code)
+        {
+            int size = words(ic);
+            if (size == 0)
+            {
+                continue;
+            }
+            if (ic.lc < end)
+            {
+                return false;
+            }
+            end = ic.lc + size;
+        }
+        return true;
+    }
+
+    // Marks the records memory operands point into. Labels that pass 1 moved
+    // off their record can point into an instruction.
+    void findPinned()
+    {
+        sortByLc();
+        pinned.assign(intermediate_code.size(), false);
+        for (const auto &ic : intermediate_code)
+        {
+            int address = dataAddress(ic);
+            auto range = address == -1 ? make_pair(size_t(0), size_t(0)) : recordsAt(address);
+            for (size_t k = range.first; k < range.second; k++)
+            {
+                pinned[by_lc[k].second] = true;
+            }
+        }
+    }
+
+    // Marks the instructions that labels lead to
+    void findTargets()
+    {
+        findPinned();
+        target.assign(intermediate_code.size(), false);
+        for (const auto &symbol : symbol_table)
+        {
+            size_t home = symbol.second == -1 ? SIZE_MAX : instructionFrom(symbol.second);
+            if (home != SIZE_MAX)
+            {
+                target[home] = true;
+            }
+        }
+    }
+
+    // Lays the program out again after records were marked removed, then
+    // drops them from the intermediate code
+    void relayout()
+    {
+        // New LC of every record; a removed one gets the LC of the record after it
+        vector<int> new_lc(intermediate_code.size());
+        int shift = 0;
+        for (size_t i = 0; i < intermediate_code.size(); i++)
+        {
+            const ICRecord &ic = intermediate_code[i];
+            if (ic.op_class == OpClass::AD && (ic.opcode == Opcode::START || ic.opcode == Opcode::ORIGIN))
+            {
+                shift = 0;
+            }
+            new_lc[i] = ic.lc - shift;
+            if (removed[i])
+            {
+                shift += words(ic);
+            }
+        }
+
+        // Symbols keep their offset into the record they point at, or move
+        // to the record after it if it was removed
+        sortByLc();
+        for (auto &symbol : symbol_table)
+        {
+            size_t home = symbol.second == -1 ? SIZE_MAX : recordAt(symbol.second);
+            if (home != SIZE_MAX)
+            {
+                symbol.second = removed[home] ? new_lc[home] : symbol.second + new_lc[home] - intermediate_code[home].lc;
+            }
+        }
+
+        // Pool n is placed by the n-th LTORG/END
+        size_t pool = 0;
+        for (size_t i = 0; i < intermediate_code.size() && pool < literal_table.poolCount(); i++)
+        {
+            const ICRecord &ic = intermediate_code[i];
+            if (ic.op_class == OpClass::AD && (ic.opcode == Opcode::LTORG || ic.opcode == Opcode::END))
+            {
+                auto range = literal_table.poolRange(pool++);
+                for (size_t l = range.first; l < range.second; l++)
+                {
+                    literal_table[l].address += new_lc[i] - ic.lc;
+                }
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < intermediate_code.size(); i++)
+        {
+            if (!removed[i])
+            {
+                intermediate_code[kept] = intermediate_code[i];
+                intermediate_code[kept].lc = new_lc[i];
+                kept++;
+            }
+        }
+        intermediate_code.resize(kept);
+        removed.assign(kept, false);
+        findPinned();
+    }
+
+public:
+    Optimizer(vector<ICRecord> &intermediate_code, SymbolTable &symbol_table, LiteralTable &literal_table)
+        : intermediate_code(intermediate_code), symbol_table(symbol_table), literal_table(literal_table),
+          removed(intermediate_code.size(), false)
+    {
+    }
+
+    const ICRecord &record(size_t i) const { return intermediate_code[i]; }
+    bool isTarget(size_t i) const { return target[i]; }
+
+    // Value of a numeric literal operand ='n'
+    bool literalConstant(const ICRecord &ic, int &value) const
+    {
+        if (ic.kind != OperandKind::LITERAL || ic.value < 1 || (size_t)ic.value > literal_table.size())
+        {
+            return false;
+        }
+        string_view text = literal_table[ic.value - 1].value;
+        if (text.size() < 4 || text.substr(0, 2) != "='" || text.back() != '\'')
+        {
+            return false;
+        }
+        text = text.substr(2, text.size() - 3);
+        if (text.find_first_not_of("0123456789", text[0] == '-' || text[0] == '+') != string_view::npos)
+        {
+            return false;
+        }
+        value = text[0] == '-' ? -toInt(text.substr(1)) : toInt(text);
+        return true;
+    }
+
+    // Address a jump goes to, -1 if the record is not a jump to a known symbol
+    int jumpTarget(const ICRecord &ic) const
+    {
+        if (!isJump(ic) || ic.reg != 0 || ic.kind != OperandKind::SYMBOL || ic.value < 1 ||
+            (size_t)ic.value > symbol_table.size())
+        {
+            return -1;
+        }
+        return symbol_table[ic.value - 1].second;
+    }
+
+    // Record i is a jump to where execution would go on anyway
+    bool jumpsToNext(size_t i) const
+    {
+        const ICRecord &ic = intermediate_code[i];
+        int address = jumpTarget(ic);
+        return address != -1 && instructionFrom(address) == instructionFrom(ic.lc + 2);
+    }
+
+    // Instruction every label points at, by symbol index; SIZE_MAX if the
+    // label is not at the start of an IS record
+    vector<size_t> labelInstructions()
+    {
+        findPinned();
+        vector<size_t> instructions(symbol_table.size(), SIZE_MAX);
+        for (size_t s = 0; s < symbol_table.size(); s++)
+        {
+            int address = symbol_table[s].second;
+            if (address != -1)
+            {
+                instructions[s] = instructionFrom(address);
+            }
+        }
+        return instructions;
+    }
+
+    // Sends every jump whose target is an unconditional JMP to the end of
+    // the chain, then removes jumps to the next instruction until none are
+    // left, as threading can leave a jump right before its new target.
+    // Returns the number of jumps retargeted, 0 without changes if the
+    // records are not laid out in source order.
+    size_t threadJumps()
+    {
+        if (!laidOutInOrder())
+        {
+            return 0;
+        }
+        vector<size_t> instructions = labelInstructions();
+
+        // Symbol at the end of the chain starting at every label, by 1-based
+        // symbol index; 0 while unknown
+        const int ON_PATH = -1;
+        vector<int> chain_end(symbol_table.size() + 1, 0);
+        vector<int> path;
+        auto endOfChain = [&](int symbol)
+        {
+            int end = symbol;
+            path.clear();
+            while (chain_end[end] == 0)
+            {
+                chain_end[end] = ON_PATH;
+                path.push_back(end);
+                size_t i = instructions[end - 1];
+                if (i == SIZE_MAX || intermediate_code[i].opcode != Opcode::JMP || jumpTarget(intermediate_code[i]) == -1)
+                {
+                    break;
+                }
+                end = intermediate_code[i].value;
+            }
+            if (chain_end[end] > 0)
+            {
+                end = chain_end[end];
+            }
+            // A loop of jumps ends where it closes
+            for (int symbol : path)
+            {
+                chain_end[symbol] = end;
+            }
+            return end;
+        };
+
+        size_t before = summary.threaded;
+        for (auto &ic : intermediate_code)
+        {
+            if (jumpTarget(ic) == -1)
+            {
+                continue;
+            }
+            int end = endOfChain(ic.value);
+            if (end != ic.value)
+            {
+                ic.value = end;
+                summary.threaded++;
+            }
+        }
+
+        size_t dropped;
+        do
+        {
+            dropped = 0;
+            for (size_t i = 0; i < intermediate_code.size(); i++)
+            {
+                if (jumpsToNext(i) && !pinned[i])
+                {
+                    drop(i, "jump-next");
+                    dropped++;
+                }
+            }
+            if (dropped > 0)
+            {
+                relayout();
+            }
+        } while (dropped > 0);
+
+        return summary.threaded - before;
+    }
+
+    // Removes the instructions that no path from the program entry (the first
+    // instruction) or from an exported label reaches, then the DC/DS
+    // declarations that neither a remaining instruction nor an exported
+    // label refers to. A jump to an EXTERN symbol leaves the module. Returns
+    // the number of records removed, 0 without changes if a reachable jump
+    // has an operand other than a symbol or if the records are not laid out
+    // in source order, where the loader overwrites some of them
+    // (dead_code_overlap.txt: the second START puts JMP DEAD over STOP).
+    size_t removeDeadCode(const vector<string_view> &exported)
+    {
+        findPinned();
+        if (!laidOutInOrder())
+        {
+            return 0;
+        }
+        size_t before = summary.removed;
+        vector<bool> live(intermediate_code.size(), false);
+        vector<size_t> work;
+
+        auto reach = [&](size_t i)
+        {
+            if (i != SIZE_MAX && !live[i])
+            {
+                live[i] = true;
+                work.push_back(i);
+            }
+        };
+
+        for (size_t i = 0; i < intermediate_code.size(); i++)
+        {
+            if (intermediate_code[i].op_class == OpClass::IS)
+            {
+                reach(i);
+                break;
+            }
+        }
+        vector<int> exported_addresses;
+        for (string_view name : exported)
+        {
+            int symbol = symbol_table.find(name);
+            if (symbol != 0 && symbol_table[symbol - 1].second != -1)
+            {
+                exported_addresses.push_back(symbol_table[symbol - 1].second);
+                reach(instructionFrom(exported_addresses.back()));
+            }
+        }
+
+        // Instructions, following fall-through and jumps
+        while (!work.empty())
+        {
+            const ICRecord &ic = intermediate_code[work.back()];
+            work.pop_back();
+            if (ic.opcode == Opcode::STOP)
+            {
+                continue;
+            }
+            if (isJump(ic))
+            {
+                int address = jumpTarget(ic);
+                if (address == -1)
+                {
+                    bool external = ic.reg == 0 && ic.kind == OperandKind::SYMBOL && ic.value >= 1 &&
+                                    (size_t)ic.value <= symbol_table.size() &&
+                                    symbol_table[ic.value - 1].second == -1;
+                    if (!external)
+                    {
+                        return 0;
+                    }
+                }
+                else
+                {
+                    reach(instructionFrom(address));
+                }
+                if (ic.opcode == Opcode::JMP)
+                {
+                    continue;
+                }
+            }
+            reach(instructionFrom(ic.lc + 2));
+        }
+
+        // Declarations, through the symbols of live instructions and exports
+        auto keepData = [&](int address)
+        {
+            auto range = recordsAt(address);
+            for (size_t k = range.first; k < range.second; k++)
+            {
+                size_t i = by_lc[k].second;
+                if (intermediate_code[i].op_class == OpClass::DL)
+                {
+                    live[i] = true;
+                }
+            }
+        };
+        for (int address : exported_addresses)
+        {
+            keepData(address);
+        }
+        for (size_t i = 0; i < intermediate_code.size(); i++)
+        {
+            int address = live[i] ? dataAddress(intermediate_code[i]) : -1;
+            if (address != -1)
+            {
+                keepData(address);
+            }
+        }
+
+        // Instructions read as data stay, even when no path reaches them
+        for (size_t i = 0; i < intermediate_code.size(); i++)
+        {
+            bool keep = live[i] || (pinned[i] && intermediate_code[i].op_class == OpClass::IS);
+            if (!keep && intermediate_code[i].op_class != OpClass::AD)
+            {
+                drop(i, intermediate_code[i].op_class == OpClass::IS ? "unreachable-code" : "dead-data");
+            }
+        }
+        if (summary.removed != before)
+        {
+            relayout();
+        }
+        return summary.removed - before;
+    }
+
+    // Applies the peephole rules in one sweep. Kept records form a stack, so
+    // a removal can expose a new match with the record before it (INCR;
+    // INCR; DECR; DECR goes away completely). A window never spans a non-IS
+    // record, a match that would drop a record read as data is skipped, and
+    // a label that pointed at a dropped record passes to the record after it.
+    // Returns the number of instructions removed, 0 without changes if the
+    // records are not laid out in source order.
+    size_t peephole()
+    {
+        if (!laidOutInOrder())
+        {
+            return 0;
+        }
+        findTargets();
+        const vector<PeepholeRule> &rules = peepholeRules();
+        size_t before = summary.removed;
+
+        vector<size_t> stack;
+        size_t run = 0;        // IS records on top of the stack
+        bool pending = false;  // a dropped record at the top was a label target
+        for (size_t i = 0; i < intermediate_code.size(); i++)
+        {
+            if (pending)
+            {
+                target[i] = true;
+                pending = false;
+            }
+            stack.push_back(i);
+            run = intermediate_code[i].op_class == OpClass::IS ? run + 1 : 0;
+
+            bool changed = true;
+            while (changed && run > 0)
+            {
+                changed = false;
+                for (const auto &rule : rules)
+                {
+                    if ((size_t)rule.width > run)
+                    {
+                        continue;
+                    }
+                    const size_t *window = stack.data() + stack.size() - rule.width;
+                    // Records read as data stay, and so does the rest of the match
+                    uint32_t drops = rule.apply(*this, window);
+                    for (int k = 0; k < rule.width; k++)
+                    {
+                        if ((drops >> k & 1) && pinned[window[k]])
+                        {
+                            drops = 0;
+                        }
+                    }
+                    if (drops == 0)
+                    {
+                        continue;
+                    }
+
+                    // Take the dropped records out of the window, in place
+                    vector<size_t> kept;
+                    bool moved_target = false;
+                    for (int k = 0; k < rule.width; k++)
+                    {
+                        if (drops >> k & 1)
+                        {
+                            moved_target = moved_target || target[window[k]];
+                            drop(window[k], rule.name);
+                        }
+                        else
+                        {
+                            target[window[k]] = target[window[k]] || moved_target;
+                            moved_target = false;
+                            kept.push_back(window[k]);
+                        }
+                    }
+                    pending = pending || moved_target;
+                    stack.resize(stack.size() - rule.width);
+                    stack.insert(stack.end(), kept.begin(), kept.end());
+                    run -= rule.width - kept.size();
+                    changed = true;
+                    break;
+                }
+            }
+        }
+
+        relayout();
+        return summary.removed - before;
+    }
+
+    const OptimizerReport &report() const { return summary; }
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cerrno>
+#include "stats.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Output sink for listings. Rows are formatted straight into one reusable
+// buffer, integers without going through a stream, and the buffer goes to
+// the file descriptor in large writes instead of one flush per row.
+class OutputWriter
+{
+private:
+    int fd;
+    bool owns_fd = false;
+    bool failed = false;
+    vector<char> buffer;
+    size_t used = 0;
+
+    void writeAll(const char *data, size_t size)
+    {
+        while (size > 0 && !failed)
+        {
+#ifdef _WIN32
+            int written = _write(fd, data, (unsigned)size);
+#else
+            ssize_t written = ::write(fd, data, size);
+#endif
+            if (written < 0)
+            {
+                failed = errno != EINTR;
+                continue;
+            }
+            STATS_ADD(bytes_written, written);
+            data += written;
+            size -= written;
+        }
+    }
+
+    // Formats value into the end of digits and returns where it starts
+    static char *formatInt(long long value, char *end)
+    {
+        unsigned long long magnitude = value < 0 ? 0ull - (unsigned long long)value : value;
+        char *start = end;
+        do
+        {
+            *--start = '0' + magnitude % 10;
+            magnitude /= 10;
+        } while (magnitude != 0);
+
+        if (value < 0)
+        {
+            *--start = '-';
+        }
+        return start;
+    }
+
+public:
+    // Writes to an open file descriptor, stdout by default
+    explicit OutputWriter(int fd = 1, size_t capacity = 1 << 16) : fd(fd), buffer(capacity) {}
+
+    // Creates or truncates filename, or with append adds to the end of an
+    // existing one; check ok() before writing
+    explicit OutputWriter(const string &filename, size_t capacity = 1 << 16, bool append = false) : buffer(capacity)
+    {
+#ifdef _WIN32
+        fd = _open(filename.c_str(), _O_WRONLY | _O_BINARY | (append ? _O_APPEND : _O_CREAT | _O_TRUNC), 0644);
+#else
+        fd = ::open(filename.c_str(), O_WRONLY | (append ? O_APPEND : O_CREAT | O_TRUNC), 0644);
+#endif
+        owns_fd = fd >= 0;
+        failed = fd < 0;
+    }
+
+    OutputWriter(const OutputWriter &) = delete;
+    OutputWriter &operator=(const OutputWriter &) = delete;
+
+    ~OutputWriter()
+    {
+        flush();
+        if (owns_fd)
+        {
+#ifdef _WIN32
+            _close(fd);
+#else
+            ::close(fd);
+#endif
+        }
+    }
+
+    // Returns false once a write has failed
+    bool flush()
+    {
+        writeAll(buffer.data(), used);
+        used = 0;
+        return !failed;
+    }
+
+    bool ok() const { return !failed; }
+
+    void write(string_view text)
+    {
+        if (used + text.size() > buffer.size())
+        {
+            flush();
+            if (text.size() > buffer.size())
+            {
+                writeAll(text.data(), text.size());
+                return;
+            }
+        }
+        text.copy(buffer.data() + used, text.size());
+        used += text.size();
+    }
+
+    void put(char c)
+    {
+        if (used == buffer.size())
+        {
+            flush();
+        }
+        buffer[used++] = c;
+    }
+
+    void writeInt(long long value)
+    {
+        char digits[24];
+        char *end = digits + sizeof(digits);
+        char *start = formatInt(value, end);
+        write(string_view(start, end - start));
+    }
+
+    void fill(char c, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            put(c);
+        }
+    }
+
+    // Left-justified column of at least width characters, like left << setw(width)
+    void column(string_view text, size_t width)
+    {
+        write(text);
+        if (text.size() < width)
+        {
+            fill(' ', width - text.size());
+        }
+    }
+
+    void column(long long value, size_t width)
+    {
+        char digits[24];
+        char *end = digits + sizeof(digits);
+        char *start = formatInt(value, end);
+        column(string_view(start, end - start), width);
+    }
+
+    void newline() { put('\n'); }
+};
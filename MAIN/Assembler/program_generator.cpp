@@ -0,0 +1,58 @@
+#include <iostream>
+#include <string>
+#include "program_generator.h"
+#include "output_writer.h"
+
+using namespace std;
+
+// Usage: program_generator LINES [--seed N] [file]
+// Writes a synthetic program of about LINES lines to file (or stdout). The
+// same LINES and seed always give the same program.
+int main(int argc, char *argv[])
+{
+    size_t lines = 0;
+    uint64_t seed = 1;
+    string filename;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc)
+        {
+            seed = stoull(argv[++i]);
+        }
+        else if (lines == 0)
+        {
+            lines = stoull(arg);
+        }
+        else
+        {
+            filename = arg;
+        }
+    }
+
+    if (lines == 0)
+    {
+        cerr << "Usage: program_generator LINES [--seed N] [file]" << endl;
+        return 1;
+    }
+
+    ProgramGenerator generator(seed);
+    string source = generator.generate(lines);
+
+    if (filename.empty())
+    {
+        OutputWriter out;
+        out.write(source);
+        return out.flush() ? 0 : 1;
+    }
+
+    OutputWriter out(filename);
+    out.write(source);
+    if (!out.flush())
+    {
+        cerr << "Error: Could not write " << filename << "!" << endl;
+        return 1;
+    }
+    return 0;
+}
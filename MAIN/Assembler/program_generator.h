@@ -0,0 +1,295 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+// Deterministic generator of large assembler sources. The same line count and
+// seed give the same program on every platform: the random numbers come from
+// a fixed xorshift generator, not from <random> distributions.
+//
+// A program is START, a few EXTERN/ENTRY directives and blocks of code and
+// data up to END. It uses every mnemonic of the assembler MOT and has:
+// - labels with backward and forward jumps to them
+// - variables defined in data blocks, referenced before and after them
+// - literals, flushed by LTORG every few dozen lines
+// - occasional ORIGIN past the current LC, and DS/DC mixes
+class ProgramGenerator
+{
+private:
+    uint64_t state;
+    string source;
+    size_t lines = 0;
+    int lc = 0;
+
+    size_t labels_defined = 0;
+    size_t labels_wanted = 0; // labels up to this number have been referenced
+    size_t variables_defined = 0;
+    size_t variables_wanted = 0;
+    vector<int> pool_literals; // values used since the last LTORG
+
+    static constexpr const char *REGISTER_NAMES[] = {"AREG", "BREG", "CREG", "DREG"};
+    static constexpr const char *REGISTER_OPCODES[] = {"MOVER", "ADD", "SUB", "COMP", "MULT", "DIV"};
+    static constexpr const char *JUMP_OPCODES[] = {"JMP", "JZ", "JNZ"};
+
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state >> 32;
+    }
+
+    // Uniform enough in [0, bound) for a workload generator
+    uint32_t below(uint32_t bound)
+    {
+        return next() % bound;
+    }
+
+    void line(const string &text)
+    {
+        source += text;
+        source += '\n';
+        lines++;
+    }
+
+    string labelName(size_t number) { return "L" + to_string(number); }
+    string variableName(size_t number) { return "V" + to_string(number); }
+
+    void instruction()
+    {
+        string text;
+        if (labels_defined < labels_wanted && below(4) == 0)
+        {
+            text = labelName(labels_defined++) + " ";
+        }
+
+        uint32_t kind = below(20);
+        string reg = REGISTER_NAMES[below(4)];
+        if (kind < 9)
+        {
+            // Register and memory operand: a variable, possibly not defined yet
+            size_t variable = below(variables_defined + 16);
+            variables_wanted = max(variables_wanted, variable + 1);
+            text += string(REGISTER_OPCODES[below(6)]) + " " + reg + ", " + variableName(variable);
+        }
+        else if (kind < 13)
+        {
+            int value = below(64);
+            bool seen = false;
+            for (int used : pool_literals)
+            {
+                seen = seen || used == value;
+            }
+            if (!seen)
+            {
+                pool_literals.push_back(value);
+            }
+            text += string(REGISTER_OPCODES[below(6)]) + " " + reg + ", ='" + to_string(value) + "'";
+        }
+        else if (kind < 14)
+        {
+            text += string(REGISTER_OPCODES[below(6)]) + " " + reg + ", " + REGISTER_NAMES[below(4)];
+        }
+        else if (kind < 17)
+        {
+            // Backward or forward jump
+            size_t target;
+            if (labels_defined > 0 && below(2) == 0)
+            {
+                target = below(labels_defined);
+            }
+            else
+            {
+                target = labels_defined + below(8);
+            }
+            labels_wanted = max(labels_wanted, target + 1);
+            text += string(JUMP_OPCODES[below(3)]) + " " + labelName(target);
+        }
+        else if (kind < 19)
+        {
+            text += string(below(2) == 0 ? "INCR " : "DECR ") + reg;
+        }
+        else
+        {
+            text += "STOP";
+        }
+
+        line(text);
+        lc += 2;
+    }
+
+    void literalPool()
+    {
+        line("LTORG");
+        lc += pool_literals.size();
+        pool_literals.clear();
+    }
+
+    void dataBlock(size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            string name = variableName(variables_defined++);
+            if (below(3) == 0)
+            {
+                int size = 1 + below(8);
+                line(name + " DS " + to_string(size));
+                lc += size;
+            }
+            else
+            {
+                line(name + " DC " + to_string(below(1000)));
+                lc++;
+            }
+        }
+    }
+
+public:
+    explicit ProgramGenerator(uint64_t seed = 1) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    // Returns a program of about line_count lines (never fewer than a dozen)
+    string generate(size_t line_count)
+    {
+        source.clear();
+        source.reserve(line_count * 16);
+        lines = 0;
+        lc = 100;
+        // L0 and V0 are ENTRY points, so they are referenced from the start
+        labels_defined = 0;
+        labels_wanted = 1;
+        variables_defined = 0;
+        variables_wanted = 1;
+        pool_literals.clear();
+
+        line("START 100");
+        line("EXTERN X0");
+        line("EXTERN X1");
+        line("ENTRY L0");
+        line("ENTRY V0");
+        line("MOVER AREG, X0");
+        line("ADD BREG, X1");
+        lc += 4;
+
+        // Leave room for defining every label and variable referenced so far
+        while (lines + 8 + (labels_wanted - labels_defined) + (variables_wanted - variables_defined) < line_count)
+        {
+            uint32_t choice = below(100);
+            if (choice < 84)
+            {
+                instruction();
+            }
+            else if (choice < 89)
+            {
+                literalPool();
+            }
+            else if (choice < 98)
+            {
+                dataBlock(1 + below(4));
+            }
+            else if (choice < 99)
+            {
+                lc += 16 + below(64);
+                line("ORIGIN " + to_string(lc));
+            }
+            else
+            {
+                // A label alone on a data line
+                if (labels_defined < labels_wanted)
+                {
+                    line(labelName(labels_defined++) + " DC 0");
+                    lc++;
+                }
+            }
+        }
+
+        // Define whatever is still referenced
+        while (labels_defined < labels_wanted)
+        {
+            line(labelName(labels_defined++) + " STOP");
+            lc += 2;
+        }
+        dataBlock(variables_wanted > variables_defined ? variables_wanted - variables_defined : 0);
+        literalPool();
+        line("END");
+        return source;
+    }
+
+    // Returns a program the simulator can run as it is: loop_count loops one
+    // after the other, each counting CREG down from iterations over a body of
+    // loads, arithmetic, COMP with forward skips and INCR/DECR, then STOP and
+    // the data. It has no EXTERN, LTORG or ORIGIN.
+    string generateLoops(size_t loop_count, int iterations)
+    {
+        static constexpr const char *BODY_REGISTERS[] = {"AREG", "BREG", "DREG"};
+        static constexpr const char *ARITHMETIC[] = {"ADD", "SUB", "MULT"};
+        const int VARIABLES = 8;
+
+        source.clear();
+        lines = 0;
+        string label; // put on the next instruction
+        size_t skips = 0;
+        auto code = [&](const string &text)
+        {
+            line(label.empty() ? text : label + " " + text);
+            label.clear();
+        };
+        auto variable = [&]() { return variableName(below(VARIABLES)); };
+
+        line("START 100");
+        for (size_t loop = 0; loop < loop_count; loop++)
+        {
+            string head = "LOOP" + to_string(loop);
+            code("MOVER CREG, N");
+            label = head;
+            for (uint32_t i = 0, body = 3 + below(6); i < body; i++)
+            {
+                string reg = BODY_REGISTERS[below(3)];
+                string skip = "SKIP" + to_string(skips);
+                switch (below(5))
+                {
+                case 0:
+                    code("MOVER " + reg + ", " + variable());
+                    code(string(below(2) == 0 ? "ADD " : "SUB ") + reg + ", " + variable());
+                    break;
+                case 1:
+                    code("COMP " + reg + ", " + variable());
+                    code(string(below(2) == 0 ? "JZ " : "JNZ ") + skip);
+                    code("ADD " + reg + ", ='" + to_string(1 + below(9)) + "'");
+                    label = skip;
+                    skips++;
+                    break;
+                case 2:
+                    code("COMP " + reg + ", " + variable());
+                    code(string(below(2) == 0 ? "INCR " : "DECR ") + reg);
+                    code(string(below(2) == 0 ? "JZ " : "JNZ ") + skip);
+                    code("MOVER " + reg + ", " + variable());
+                    label = skip;
+                    skips++;
+                    break;
+                case 3:
+                    code(string(ARITHMETIC[below(3)]) + " " + reg + ", " + variable());
+                    break;
+                default:
+                    code(string(below(2) == 0 ? "INCR " : "DECR ") + reg);
+                    break;
+                }
+            }
+            code("DECR CREG");
+            code("COMP CREG, ZERO");
+            code("JNZ " + head);
+        }
+        code("STOP");
+
+        line("N DC " + to_string(iterations));
+        line("ZERO DC 0");
+        for (int i = 0; i < VARIABLES; i++)
+        {
+            line(variableName(i) + " DC " + to_string(below(100)));
+        }
+        line("END");
+        return source;
+    }
+};
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <chrono>
+#include "assembler.h"
+#include "simulator.h"
+#include "block_cache.h"
+
+using namespace std;
+
+// Usage: simulator [--optimize] [--thread-jumps] [--remove-dead] [--blocks] [--no-fuse]
+//                  [--max-steps N] [--repeat N] [--set NAME=VALUE]... [file | -]
+// Assembles a source (or takes an object file written with --object as it
+// is), loads it and runs it from its first instruction, then prints how the
+// run ended, the registers and the simulated instructions per second. --set
+// writes a value to the memory word of a symbol before the run, for instance
+// --set TARGET=100000000 to make the project2_1.txt search loop long,
+// --repeat runs the program that many times from a fresh state and
+// --max-steps bounds every run. --blocks runs through the basic-block
+// translation cache instead of one instruction at a time, --no-fuse turns
+// the superinstructions off. The optimizer options are those of assignment1
+// and only apply to a source.
+int main(int argc, char *argv[])
+{
+    string filename;
+    AssemblerOptions options;
+    uint64_t max_steps = UINT64_MAX;
+    uint64_t repeat = 1;
+    bool use_blocks = false;
+    bool fuse = true;
+    vector<pair<string, int64_t>> settings;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--optimize")
+        {
+            options.optimize = true;
+        }
+        else if (arg == "--thread-jumps")
+        {
+            options.thread_jumps = true;
+        }
+        else if (arg == "--remove-dead")
+        {
+            options.remove_dead = true;
+        }
+        else if (arg == "--blocks")
+        {
+            use_blocks = true;
+        }
+        else if (arg == "--no-fuse")
+        {
+            fuse = false;
+        }
+        else if (arg == "--max-steps" && i + 1 < argc)
+        {
+            max_steps = stoull(argv[++i]);
+        }
+        else if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = max(stoull(argv[++i]), 1ull);
+        }
+        else if (arg == "--set" && i + 1 < argc)
+        {
+            string setting = argv[++i];
+            size_t equals = setting.find('=');
+            if (equals == string::npos)
+            {
+                cerr << "Error: --set needs NAME=VALUE!" << endl;
+                return 1;
+            }
+            settings.push_back({setting.substr(0, equals), stoll(setting.substr(equals + 1))});
+        }
+        else
+        {
+            filename = arg;
+        }
+    }
+
+    if (filename.empty())
+    {
+        cerr << "Usage: simulator [--optimize] [--thread-jumps] [--remove-dead] [--blocks] [--no-fuse]" << endl
+             << "                 [--max-steps N] [--repeat N] [--set NAME=VALUE]... file" << endl;
+        return 1;
+    }
+
+    LoadedProgram program;
+    if (!loadProgram(filename, options, program))
+    {
+        return 1;
+    }
+
+    Simulator simulator(program.image, fuse);
+    BlockCache cache(use_blocks ? move(program.image) : ProgramImage(), fuse);
+    MachineState initial = simulator.initialState();
+    for (const auto &setting : settings)
+    {
+        int symbol = program.symbols.find(setting.first);
+        if (symbol == 0 || !simulator.write(initial, program.symbols[symbol - 1].second, setting.second))
+        {
+            cerr << "Error: " << setting.first << " is not a symbol in the program's memory!" << endl;
+            return 1;
+        }
+    }
+
+    MachineState state;
+    SimResult result;
+    uint64_t total_steps = 0;
+    auto begin = chrono::steady_clock::now();
+    for (uint64_t run = 0; run < repeat; run++)
+    {
+        state = initial;
+        result = use_blocks ? cache.run(state, max_steps) : simulator.run(state, max_steps);
+        total_steps += result.steps;
+    }
+    auto finish = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(finish - begin).count();
+
+    cout << "Status:        " << simStatusName(result.status);
+    if (state.pc != -1 && result.status != SimStatus::END_OF_CODE)
+    {
+        cout << " at " << state.pc;
+    }
+    cout << endl;
+    cout << "Instructions:  " << result.steps << endl;
+    cout << "Registers:     AREG " << state.registers[1] << "  BREG " << state.registers[2]
+         << "  CREG " << state.registers[3] << "  DREG " << state.registers[4] << endl;
+    cout << "Condition:     " << (state.zero ? "zero" : "not zero") << endl;
+    cout << "Dispatches:    " << result.steps - result.fused << endl;
+    if (use_blocks)
+    {
+        cout << "Blocks:        " << cache.blockCount() << endl;
+    }
+    cout << "Time (ms):     " << fixed << setprecision(2) << seconds * 1000 << endl;
+    cout << "Instr/sec:     " << setprecision(0) << total_steps / max(seconds, 1e-9) << endl;
+    return result.status == SimStatus::STOPPED || result.status == SimStatus::END_OF_CODE ? 0 : 2;
+}
@@ -0,0 +1,827 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <climits>
+#include <memory>
+#include <atomic>
+#include "assembler.h"
+#include "optimizer.h"
+#include "object_file.h"
+
+using namespace std;
+
+// Simulator for assembled programs. The program is loaded into a flat memory
+// image, one 64-bit word per address, and decoded once into an array of
+// instructions with their operands and successors resolved, which a
+// threaded interpreter then runs: every handler ends with an indirect jump
+// to the next handler (computed goto on GCC and Clang, a switch elsewhere).
+//
+// Machine model, shared with the optimizer:
+// - AREG..DREG hold 64-bit integers; arithmetic wraps around
+// - MOVER loads a register, ADD/SUB/MULT/DIV combine it with the operand,
+//   INCR/DECR add or subtract one; the operand is a register or a memory word
+// - only COMP sets the condition: zero when the register equals the operand;
+//   JZ jumps when it is set, JNZ when it is not
+// - no instruction writes memory
+// - code and data share the addresses, but code is not readable as data: a
+//   memory operand that falls on an instruction's words reads 0
+// - execution goes on at the first instruction at or after an address (LC + 2,
+//   or a jump's target), so declarations in the way are skipped; it ends at
+//   STOP, when no instruction follows, or at a jump to an EXTERN symbol
+//
+// The machine code leaves jump targets out ("00"), so the image is built from
+// the code words of the object file (see object_file.h): the intermediate
+// code with every operand resolved, jump targets included.
+
+// What the operand field of an instruction word holds
+enum class OperandMode : uint8_t
+{
+    NONE,
+    REGISTER, // register code
+    MEMORY,   // address
+    TARGET    // jump target address, -1 for an EXTERN symbol
+};
+
+// An instruction word: opcode in bits 48-55, register in 40-47, operand mode
+// in 32-39 and the operand in the low 32 bits. IS opcodes start at 1, so an
+// instruction word is never 0.
+struct InstructionWord
+{
+    uint8_t opcode;
+    uint8_t reg;
+    OperandMode mode;
+    int32_t operand;
+};
+
+inline int64_t encodeInstruction(const InstructionWord &word)
+{
+    return (int64_t)word.opcode << 48 | (int64_t)word.reg << 40 | (int64_t)word.mode << 32 | (uint32_t)word.operand;
+}
+
+inline InstructionWord decodeInstruction(int64_t word)
+{
+    return {uint8_t(word >> 48), uint8_t(word >> 40), OperandMode(uint8_t(word >> 32)), int32_t(uint32_t(word))};
+}
+
+struct ProgramImage
+{
+    int base = 0;         // address of the first word
+    vector<int64_t> data; // DC constants, DS blocks and literals, 0 elsewhere
+    vector<int64_t> code; // instruction words where instructions start, 0 elsewhere
+    int entry = -1;       // address of the first instruction, -1 without one
+
+    size_t size() const { return data.size(); }
+
+    bool contains(int address) const
+    {
+        return address >= base && (int64_t)address - base < (int64_t)data.size();
+    }
+};
+
+// Value of a literal ='n'; literals that are not numbers load as 0
+inline int64_t literalValue(string_view literal)
+{
+    if (literal.size() < 4 || literal.substr(0, 2) != "='" || literal.back() != '\'')
+    {
+        return 0;
+    }
+    literal = literal.substr(2, literal.size() - 3);
+    bool negative = literal[0] == '-';
+    return negative ? -toInt(literal.substr(1)) : toInt(literal);
+}
+
+// Lays out code words in memory: instructions, DC constants, DS blocks
+// (zeroed) and the literals, given as (address, value)
+inline ProgramImage layoutImage(SectionView<CodeWord> code, const vector<pair<int, int64_t>> &literals)
+{
+    ProgramImage image;
+
+    // The image spans every record and literal that takes words
+    int low = INT_MAX, high = INT_MIN;
+    auto span = [&](int address, int words)
+    {
+        if (address >= 0 && words > 0)
+        {
+            low = min(low, address);
+            high = max(high, address + words);
+        }
+    };
+    for (const auto &word : code)
+    {
+        OpClass op_class = (OpClass)word.op_class;
+        span(word.lc, op_class == OpClass::IS ? 2 : op_class == OpClass::DL ? (word.opcode == Opcode::DS ? word.operand : 1) : 0);
+    }
+    for (const auto &literal : literals)
+    {
+        span(literal.first, 1);
+    }
+    if (low > high)
+    {
+        return image;
+    }
+    image.base = low;
+    image.data.assign(high - low, 0);
+    image.code.assign(high - low, 0);
+
+    for (const auto &literal : literals)
+    {
+        if (literal.first >= 0)
+        {
+            image.data[literal.first - low] = literal.second;
+        }
+    }
+
+    // A later record replaces the words of an earlier one (ORIGIN can go back)
+    for (const auto &word : code)
+    {
+        OpClass op_class = (OpClass)word.op_class;
+        OperandKind kind = (OperandKind)word.kind;
+        if (op_class == OpClass::DL && word.lc >= 0)
+        {
+            int size = word.opcode == Opcode::DS ? word.operand : 1;
+            for (int i = 0; i < size; i++)
+            {
+                image.data[word.lc - low + i] = word.opcode == Opcode::DS ? 0 : word.operand;
+                image.code[word.lc - low + i] = 0;
+            }
+        }
+        if (op_class != OpClass::IS || word.lc < 0)
+        {
+            continue;
+        }
+
+        InstructionWord instruction = {word.opcode, word.reg, OperandMode::NONE, 0};
+        bool jump = word.opcode == Opcode::JMP || word.opcode == Opcode::JZ || word.opcode == Opcode::JNZ;
+        if (jump && word.reg == 0 && kind == OperandKind::SYMBOL)
+        {
+            instruction.mode = OperandMode::TARGET;
+            instruction.operand = word.operand;
+        }
+        else if (word.reg != 0 && (kind == OperandKind::SYMBOL || kind == OperandKind::LITERAL))
+        {
+            instruction.mode = OperandMode::MEMORY;
+            instruction.operand = word.operand;
+        }
+        else if (word.reg != 0 && kind == OperandKind::REGISTER)
+        {
+            instruction.mode = OperandMode::REGISTER;
+            instruction.operand = word.operand;
+        }
+        // An instruction over the second word of another replaces it too, so
+        // no two instructions are one word apart
+        image.code[word.lc - low] = encodeInstruction(instruction);
+        image.code[word.lc - low + 1] = 0;
+        image.data[word.lc - low] = 0;
+        image.data[word.lc - low + 1] = 0;
+        if (word.lc > low)
+        {
+            image.code[word.lc - low - 1] = 0;
+        }
+        if (image.entry == -1)
+        {
+            image.entry = word.lc;
+        }
+    }
+    return image;
+}
+
+// Lays out the records of an assembled module in memory
+inline ProgramImage loadImage(const ObjectModule &module)
+{
+    vector<CodeWord> code = objectCode(module);
+    vector<pair<int, int64_t>> literals;
+    for (const auto &literal : module.literal_table)
+    {
+        literals.push_back({literal.address, literalValue(literal.value)});
+    }
+    return layoutImage({code.data(), code.size()}, literals);
+}
+
+// Lays out the records of an object file in memory, straight from its
+// CODE and LITERALS sections
+inline ProgramImage loadImage(const ObjectFile &object)
+{
+    vector<pair<int, int64_t>> literals;
+    for (const auto &literal : object.literals())
+    {
+        literals.push_back({literal.address, literalValue(object.name(literal.name_offset, literal.name_length))});
+    }
+    return layoutImage(object.code(), literals);
+}
+
+// A program ready to load into a Simulator, with the symbols that name its words
+struct LoadedProgram
+{
+    ProgramImage image;
+    SymbolTable symbols;
+};
+
+// Loads an object file written with --object as it is, or assembles a source
+// with options (printing the optimizer report) and loads that. Reports a file
+// it cannot use on stderr and returns false.
+inline bool loadProgram(const string &filename, const AssemblerOptions &options, LoadedProgram &program)
+{
+    SourceReader input;
+    if (!input.open(filename))
+    {
+        cerr << "Error: Could not open input file!" << endl;
+        return false;
+    }
+    if (hasObjectMagic(input.text()))
+    {
+        ObjectFile object;
+        if (!object.open(filename))
+        {
+            cerr << "Error: " << filename << " is not a valid object file!" << endl;
+            return false;
+        }
+        program.image = loadImage(object);
+        program.symbols = object.symbolTable();
+        return true;
+    }
+
+    Assembler assembler(options);
+    ObjectModule module = assembler.assemble(input.text());
+    if (options.optimizing())
+    {
+        printOptimizerReport(assembler.optimizerReport());
+    }
+    program.image = loadImage(module);
+    program.symbols = move(module.symbol_table);
+    return true;
+}
+
+enum class SimStatus : uint8_t
+{
+    STOPPED,             // ran STOP
+    END_OF_CODE,         // no instruction at or after the next address
+    EXTERN_JUMP,         // jumped to an EXTERN symbol
+    ILLEGAL_INSTRUCTION, // opcode and operands do not make an instruction
+    BAD_ADDRESS,         // memory operand outside the image
+    DIVIDE_BY_ZERO,
+    STEP_LIMIT           // ran the number of instructions it was given
+};
+
+inline const char *simStatusName(SimStatus status)
+{
+    switch (status)
+    {
+    case SimStatus::STOPPED:
+        return "stopped";
+    case SimStatus::END_OF_CODE:
+        return "end of code";
+    case SimStatus::EXTERN_JUMP:
+        return "jump to an EXTERN symbol";
+    case SimStatus::ILLEGAL_INSTRUCTION:
+        return "illegal instruction";
+    case SimStatus::BAD_ADDRESS:
+        return "bad address";
+    case SimStatus::DIVIDE_BY_ZERO:
+        return "divide by zero";
+    default:
+        return "step limit";
+    }
+}
+
+struct SimResult
+{
+    SimStatus status = SimStatus::STOPPED;
+    uint64_t steps = 0; // instructions executed
+    uint64_t fused = 0; // pairs of them run by one superinstruction
+};
+
+// Memory words of a state. No instruction writes memory, so copies of a
+// state share their words until one of them is written with set(), which
+// gives that copy words of its own first: a thousand states made from one
+// initial state hold one image, plus one for each state given inputs.
+// Copies can live on different threads; one copy is not to be written from
+// two threads at once.
+class DataSegment
+{
+private:
+    shared_ptr<vector<int64_t>> words;
+
+public:
+    DataSegment() = default;
+    DataSegment(vector<int64_t> values) : words(make_shared<vector<int64_t>>(move(values))) {}
+
+    const int64_t *data() const { return words ? words->data() : nullptr; }
+    size_t size() const { return words ? words->size() : 0; }
+    int64_t operator[](size_t index) const { return (*words)[index]; }
+
+    // True while other copies share the words
+    bool shared() const { return words.use_count() > 1; }
+
+    void set(size_t index, int64_t value)
+    {
+        if (shared())
+        {
+            words = make_shared<vector<int64_t>>(*words);
+        }
+        else
+        {
+            // Order the write after the reads of copies released on other threads
+            atomic_thread_fence(memory_order_acquire);
+        }
+        (*words)[index] = value;
+    }
+};
+
+// Registers, condition and memory of one run. Runs can be resumed: pc is the
+// address execution goes on at, -1 after a jump out of the module.
+struct MachineState
+{
+    int64_t registers[5] = {}; // AREG..DREG at their register codes
+    bool zero = false;         // condition set by COMP
+    int pc = -1;
+    DataSegment memory;
+};
+
+// Handler of a decoded instruction. _M takes a memory operand, _R a register.
+enum class SimOp : uint8_t
+{
+    MOVER_M,
+    MOVER_R,
+    ADD_M,
+    ADD_R,
+    SUB_M,
+    SUB_R,
+    MULT_M,
+    MULT_R,
+    DIV_M,
+    DIV_R,
+    COMP_M,
+    COMP_R,
+    INCR,
+    DECR,
+    JMP,
+    JZ,
+    JNZ,
+    STOP,
+    END,         // past the last instruction
+    EXTERN,      // a jump left the module
+    ILLEGAL,
+    BAD_ADDRESS,
+    // Superinstructions: an instruction and the one after it in one dispatch
+    COMP_M_JZ,
+    COMP_M_JNZ,
+    COMP_R_JZ,
+    COMP_R_JNZ,
+    INCR_JZ,
+    INCR_JNZ,
+    DECR_JZ,
+    DECR_JNZ,
+    MOVER_ADD, // MOVER and ADD of one register, both from memory
+    MOVER_SUB,
+    COUNT
+};
+
+// Execution goes on at the next instruction in the array: instructions are in
+// address order, and one at LC + 1 would overlap, so the first at or after
+// LC + 2 is always the next one.
+//
+// A superinstruction replaces only the op of the first instruction of its
+// pair; the second keeps its own entry, so a jump to it still lands on it.
+struct SimInstruction
+{
+    SimOp op;
+    SimOp plain; // op before fusion
+    uint8_t reg;
+    int32_t operand; // memory index (address - base) or register code
+    uint32_t target; // where a jump goes; for a superinstruction, the jump
+                     // target or memory operand of the second instruction
+    int32_t lc;
+};
+
+// -DSIMULATOR_SWITCH_DISPATCH builds the switch version on GCC and Clang too
+#if defined(__GNUC__) && !defined(SIMULATOR_SWITCH_DISPATCH)
+#define SIMULATOR_COMPUTED_GOTO
+#endif
+
+class Simulator
+{
+private:
+    ProgramImage image;
+    vector<SimInstruction> program; // instructions in address order, then END and EXTERN
+    vector<uint32_t> from;          // per memory word: first instruction at or after it
+    uint32_t end_index = 0;
+    uint32_t extern_index = 0;
+    DataSegment loaded; // image.data for initialState()
+
+    static int64_t wrapAdd(int64_t a, int64_t b) { return (int64_t)((uint64_t)a + (uint64_t)b); }
+    static int64_t wrapSub(int64_t a, int64_t b) { return (int64_t)((uint64_t)a - (uint64_t)b); }
+    static int64_t wrapMult(int64_t a, int64_t b) { return (int64_t)((uint64_t)a * (uint64_t)b); }
+
+    SimInstruction decode(int lc, const InstructionWord &word) const
+    {
+        SimInstruction instruction = {SimOp::ILLEGAL, SimOp::ILLEGAL, word.reg, 0, 0, lc};
+        bool has_register = word.reg >= 1 && word.reg <= 4;
+
+        switch (word.opcode)
+        {
+        case Opcode::STOP:
+            instruction.op = SimOp::STOP;
+            return instruction;
+        case Opcode::INCR:
+        case Opcode::DECR:
+            if (has_register)
+            {
+                instruction.op = word.opcode == Opcode::INCR ? SimOp::INCR : SimOp::DECR;
+            }
+            return instruction;
+        case Opcode::JMP:
+        case Opcode::JZ:
+        case Opcode::JNZ:
+            if (word.mode == OperandMode::TARGET)
+            {
+                instruction.op = word.opcode == Opcode::JMP ? SimOp::JMP : word.opcode == Opcode::JZ ? SimOp::JZ : SimOp::JNZ;
+                instruction.target = word.operand == -1 ? extern_index : instructionFrom(word.operand);
+            }
+            return instruction;
+        default:
+            break;
+        }
+
+        static const SimOp memory_ops[] = {SimOp::ILLEGAL, SimOp::MOVER_M, SimOp::ADD_M, SimOp::SUB_M, SimOp::ILLEGAL,
+                                           SimOp::COMP_M, SimOp::ILLEGAL, SimOp::ILLEGAL, SimOp::ILLEGAL, SimOp::ILLEGAL,
+                                           SimOp::ILLEGAL, SimOp::MULT_M, SimOp::DIV_M};
+        if (word.opcode >= size(memory_ops) || memory_ops[word.opcode] == SimOp::ILLEGAL || !has_register)
+        {
+            return instruction;
+        }
+        // The register form of every operation follows its memory form
+        SimOp op = memory_ops[word.opcode];
+        if (word.mode == OperandMode::REGISTER && word.operand >= 1 && word.operand <= 4)
+        {
+            instruction.op = SimOp((int)op + 1);
+            instruction.operand = word.operand;
+        }
+        else if (word.mode == OperandMode::MEMORY)
+        {
+            instruction.op = image.contains(word.operand) ? op : SimOp::BAD_ADDRESS;
+            instruction.operand = image.contains(word.operand) ? word.operand - image.base : 0;
+        }
+        return instruction;
+    }
+
+    // Turns the first instruction of every common pair into a superinstruction:
+    // COMP or INCR/DECR before JZ/JNZ, and MOVER before ADD/SUB of the same
+    // register. Only JZ/JNZ and ADD/SUB end a pair, and they never start one,
+    // so pairs do not overlap.
+    void fusePairs()
+    {
+        for (uint32_t i = 0; i + 1 < end_index; i++)
+        {
+            SimInstruction &first = program[i];
+            const SimInstruction &second = program[i + 1];
+            bool branch = second.op == SimOp::JZ || second.op == SimOp::JNZ;
+            bool jnz = second.op == SimOp::JNZ;
+            if (branch && (first.op == SimOp::COMP_M || first.op == SimOp::COMP_R))
+            {
+                first.op = first.op == SimOp::COMP_M ? (jnz ? SimOp::COMP_M_JNZ : SimOp::COMP_M_JZ)
+                                                     : (jnz ? SimOp::COMP_R_JNZ : SimOp::COMP_R_JZ);
+                first.target = second.target;
+            }
+            else if (branch && (first.op == SimOp::INCR || first.op == SimOp::DECR))
+            {
+                first.op = first.op == SimOp::INCR ? (jnz ? SimOp::INCR_JNZ : SimOp::INCR_JZ)
+                                                   : (jnz ? SimOp::DECR_JNZ : SimOp::DECR_JZ);
+                first.target = second.target;
+            }
+            else if (first.op == SimOp::MOVER_M && (second.op == SimOp::ADD_M || second.op == SimOp::SUB_M) &&
+                     first.reg == second.reg)
+            {
+                first.op = second.op == SimOp::ADD_M ? SimOp::MOVER_ADD : SimOp::MOVER_SUB;
+                first.target = second.operand;
+            }
+        }
+    }
+
+public:
+    // fuse = false keeps one dispatch per instruction, to measure fusion
+    explicit Simulator(ProgramImage program_image, bool fuse = true) : image(move(program_image)), loaded(image.data)
+    {
+        vector<int> starts;
+        for (size_t i = 0; i < image.size(); i++)
+        {
+            if (image.code[i] != 0)
+            {
+                starts.push_back(image.base + i);
+            }
+        }
+        end_index = starts.size();
+        extern_index = end_index + 1;
+
+        from.assign(image.size() + 1, end_index);
+        for (size_t i = image.size(), next = end_index; i-- > 0;)
+        {
+            if (image.code[i] != 0)
+            {
+                next--;
+            }
+            from[i] = next;
+        }
+
+        program.reserve(starts.size() + 2);
+        for (int lc : starts)
+        {
+            program.push_back(decode(lc, decodeInstruction(image.code[lc - image.base])));
+        }
+        program.push_back({SimOp::END, SimOp::END, 0, 0, end_index, image.base + (int)image.size()});
+        program.push_back({SimOp::EXTERN, SimOp::EXTERN, 0, 0, extern_index, -1});
+        for (auto &instruction : program)
+        {
+            instruction.plain = instruction.op;
+        }
+        if (fuse)
+        {
+            fusePairs();
+        }
+    }
+
+    // Index of the first instruction at or after address
+    uint32_t instructionFrom(int address) const
+    {
+        if (address < image.base)
+        {
+            return from.empty() ? end_index : from[0];
+        }
+        if ((int64_t)address - image.base >= (int64_t)image.size())
+        {
+            return end_index;
+        }
+        return from[address - image.base];
+    }
+
+    const ProgramImage &programImage() const { return image; }
+    size_t instructionCount() const { return end_index; }
+
+    // Decoded instruction at an index from instructionFrom(); the one at
+    // instructionCount() is END
+    const SimInstruction &instruction(uint32_t index) const { return program[index]; }
+
+    // A fresh state at the entry with the loaded memory, shared with every
+    // other state until written
+    MachineState initialState() const
+    {
+        MachineState state;
+        state.pc = image.entry == -1 ? image.base + (int)image.size() : image.entry;
+        state.memory = loaded;
+        return state;
+    }
+
+    // Writes a memory word of a state, false if address is outside the image
+    bool write(MachineState &state, int address, int64_t value) const
+    {
+        if (!image.contains(address))
+        {
+            return false;
+        }
+        state.memory.set(address - image.base, value);
+        return true;
+    }
+
+    // Runs from state.pc for at most max_steps instructions. Safe to call on
+    // one Simulator from several threads with different states.
+    SimResult run(MachineState &state, uint64_t max_steps = UINT64_MAX) const
+    {
+        const SimInstruction *code = program.data();
+        const SimInstruction *ip = code + (state.pc == -1 ? extern_index : instructionFrom(state.pc));
+        const int64_t *memory = state.memory.data();
+        int64_t r[5] = {state.registers[0], state.registers[1], state.registers[2], state.registers[3], state.registers[4]};
+        bool zero = state.zero;
+        uint64_t left = max_steps;
+        uint64_t fused = 0;
+        SimStatus status;
+
+#ifdef SIMULATOR_COMPUTED_GOTO
+        // In SimOp order
+        static const void *const handlers[] = {
+            &&op_MOVER_M, &&op_MOVER_R, &&op_ADD_M, &&op_ADD_R, &&op_SUB_M, &&op_SUB_R, &&op_MULT_M, &&op_MULT_R,
+            &&op_DIV_M, &&op_DIV_R, &&op_COMP_M, &&op_COMP_R, &&op_INCR, &&op_DECR, &&op_JMP, &&op_JZ, &&op_JNZ,
+            &&op_STOP, &&op_END, &&op_EXTERN, &&op_ILLEGAL, &&op_BAD_ADDRESS,
+            &&op_COMP_M_JZ, &&op_COMP_M_JNZ, &&op_COMP_R_JZ, &&op_COMP_R_JNZ, &&op_INCR_JZ, &&op_INCR_JNZ,
+            &&op_DECR_JZ, &&op_DECR_JNZ, &&op_MOVER_ADD, &&op_MOVER_SUB};
+        static_assert(size(handlers) == (size_t)SimOp::COUNT, "one handler per SimOp");
+#define DISPATCH()                          \
+    do                                      \
+    {                                       \
+        if (left == 0)                      \
+        {                                   \
+            goto step_limit;                \
+        }                                   \
+        left--;                             \
+        goto *handlers[(int)ip->op];        \
+    } while (0)
+#define HANDLER(name) op_##name:
+        DISPATCH();
+#else
+#define DISPATCH() goto dispatch
+#define HANDLER(name) case SimOp::name:
+        SimOp current;
+    dispatch:
+        if (left == 0)
+        {
+            goto step_limit;
+        }
+        left--;
+        current = ip->op;
+    execute:
+        switch (current)
+        {
+#endif
+// A superinstruction takes a second step, or runs its first instruction
+// alone when there is none left
+#define SECOND()       \
+    if (left == 0)     \
+    {                  \
+        goto split;    \
+    }                  \
+    left--;            \
+    fused++
+        HANDLER(MOVER_M)
+        r[ip->reg] = memory[ip->operand];
+        ip++;
+        DISPATCH();
+        HANDLER(MOVER_R)
+        r[ip->reg] = r[ip->operand];
+        ip++;
+        DISPATCH();
+        HANDLER(ADD_M)
+        r[ip->reg] = wrapAdd(r[ip->reg], memory[ip->operand]);
+        ip++;
+        DISPATCH();
+        HANDLER(ADD_R)
+        r[ip->reg] = wrapAdd(r[ip->reg], r[ip->operand]);
+        ip++;
+        DISPATCH();
+        HANDLER(SUB_M)
+        r[ip->reg] = wrapSub(r[ip->reg], memory[ip->operand]);
+        ip++;
+        DISPATCH();
+        HANDLER(SUB_R)
+        r[ip->reg] = wrapSub(r[ip->reg], r[ip->operand]);
+        ip++;
+        DISPATCH();
+        HANDLER(MULT_M)
+        r[ip->reg] = wrapMult(r[ip->reg], memory[ip->operand]);
+        ip++;
+        DISPATCH();
+        HANDLER(MULT_R)
+        r[ip->reg] = wrapMult(r[ip->reg], r[ip->operand]);
+        ip++;
+        DISPATCH();
+        HANDLER(DIV_M)
+        {
+            int64_t divisor = memory[ip->operand];
+            if (divisor == 0)
+            {
+                goto divide_by_zero;
+            }
+            r[ip->reg] = divisor == -1 ? wrapSub(0, r[ip->reg]) : r[ip->reg] / divisor;
+        }
+        ip++;
+        DISPATCH();
+        HANDLER(DIV_R)
+        {
+            int64_t divisor = r[ip->operand];
+            if (divisor == 0)
+            {
+                goto divide_by_zero;
+            }
+            r[ip->reg] = divisor == -1 ? wrapSub(0, r[ip->reg]) : r[ip->reg] / divisor;
+        }
+        ip++;
+        DISPATCH();
+        HANDLER(COMP_M)
+        zero = r[ip->reg] == memory[ip->operand];
+        ip++;
+        DISPATCH();
+        HANDLER(COMP_R)
+        zero = r[ip->reg] == r[ip->operand];
+        ip++;
+        DISPATCH();
+        HANDLER(INCR)
+        r[ip->reg] = wrapAdd(r[ip->reg], 1);
+        ip++;
+        DISPATCH();
+        HANDLER(DECR)
+        r[ip->reg] = wrapSub(r[ip->reg], 1);
+        ip++;
+        DISPATCH();
+        HANDLER(JMP)
+        ip = code + ip->target;
+        DISPATCH();
+        HANDLER(JZ)
+        ip = zero ? code + ip->target : ip + 1;
+        DISPATCH();
+        HANDLER(JNZ)
+        ip = zero ? ip + 1 : code + ip->target;
+        DISPATCH();
+        HANDLER(COMP_M_JZ)
+        SECOND();
+        zero = r[ip->reg] == memory[ip->operand];
+        ip = zero ? code + ip->target : ip + 2;
+        DISPATCH();
+        HANDLER(COMP_M_JNZ)
+        SECOND();
+        zero = r[ip->reg] == memory[ip->operand];
+        ip = zero ? ip + 2 : code + ip->target;
+        DISPATCH();
+        HANDLER(COMP_R_JZ)
+        SECOND();
+        zero = r[ip->reg] == r[ip->operand];
+        ip = zero ? code + ip->target : ip + 2;
+        DISPATCH();
+        HANDLER(COMP_R_JNZ)
+        SECOND();
+        zero = r[ip->reg] == r[ip->operand];
+        ip = zero ? ip + 2 : code + ip->target;
+        DISPATCH();
+        HANDLER(INCR_JZ)
+        SECOND();
+        r[ip->reg] = wrapAdd(r[ip->reg], 1);
+        ip = zero ? code + ip->target : ip + 2;
+        DISPATCH();
+        HANDLER(INCR_JNZ)
+        SECOND();
+        r[ip->reg] = wrapAdd(r[ip->reg], 1);
+        ip = zero ? ip + 2 : code + ip->target;
+        DISPATCH();
+        HANDLER(DECR_JZ)
+        SECOND();
+        r[ip->reg] = wrapSub(r[ip->reg], 1);
+        ip = zero ? code + ip->target : ip + 2;
+        DISPATCH();
+        HANDLER(DECR_JNZ)
+        SECOND();
+        r[ip->reg] = wrapSub(r[ip->reg], 1);
+        ip = zero ? ip + 2 : code + ip->target;
+        DISPATCH();
+        HANDLER(MOVER_ADD)
+        SECOND();
+        r[ip->reg] = wrapAdd(memory[ip->operand], memory[ip->target]);
+        ip += 2;
+        DISPATCH();
+        HANDLER(MOVER_SUB)
+        SECOND();
+        r[ip->reg] = wrapSub(memory[ip->operand], memory[ip->target]);
+        ip += 2;
+        DISPATCH();
+        HANDLER(STOP)
+        status = SimStatus::STOPPED;
+        goto done;
+        // The rest are not instructions and do not count as steps
+        HANDLER(END)
+        left++;
+        status = SimStatus::END_OF_CODE;
+        goto done;
+        HANDLER(EXTERN)
+        left++;
+        status = SimStatus::EXTERN_JUMP;
+        goto done;
+        HANDLER(BAD_ADDRESS)
+        left++;
+        status = SimStatus::BAD_ADDRESS;
+        goto done;
+#ifndef SIMULATOR_COMPUTED_GOTO
+        default:
+#endif
+        HANDLER(ILLEGAL)
+        left++;
+        status = SimStatus::ILLEGAL_INSTRUCTION;
+        goto done;
+#ifndef SIMULATOR_COMPUTED_GOTO
+        }
+#endif
+#undef SECOND
+#undef DISPATCH
+#undef HANDLER
+
+    split:
+#ifdef SIMULATOR_COMPUTED_GOTO
+        goto *handlers[(int)ip->plain];
+#else
+        current = ip->plain;
+        goto execute;
+#endif
+    divide_by_zero:
+        left++;
+        status = SimStatus::DIVIDE_BY_ZERO;
+        goto done;
+    step_limit:
+        status = SimStatus::STEP_LIMIT;
+    done:
+        for (int i = 0; i < 5; i++)
+        {
+            state.registers[i] = r[i];
+        }
+        state.zero = zero;
+        state.pc = ip->lc;
+        return {status, max_steps - left, fused};
+    }
+};
@@ -0,0 +1,160 @@
+#include <iostream>
+#include <string>
+#include <iomanip>
+#include <chrono>
+#include "assembler.h"
+#include "program_generator.h"
+#include "simulator.h"
+#include "block_cache.h"
+
+using namespace std;
+
+// Simulator benchmark on generated loop programs.
+// Every program comes from ProgramGenerator::generateLoops() with its own
+// seed, is assembled once and run three ways: one dispatch per instruction,
+// with superinstructions (COMP, INCR or DECR fused with JZ/JNZ, MOVER with
+// ADD/SUB) and through the basic-block cache. Each row shows the instructions,
+// the dispatches they took and the simulated instructions per second; the
+// runs have to agree on the final registers.
+//
+// Then the warm cache of every program is patched a few times, each time
+// copying one of its instructions over another, and has to run the same as a
+// simulator decoded from scratch from the patched image.
+//
+// Usage: simulator_bench [--programs N] [--loops N] [--iterations N] [--seed N]
+
+struct ModeResult
+{
+    SimResult result;
+    MachineState state;
+    double ms = 0;
+};
+
+template <typename Engine>
+ModeResult measure(Engine &engine, const MachineState &initial)
+{
+    ModeResult mode;
+    mode.state = initial;
+    auto begin = chrono::steady_clock::now();
+    mode.result = engine.run(mode.state);
+    auto finish = chrono::steady_clock::now();
+    mode.ms = chrono::duration<double, milli>(finish - begin).count();
+    return mode;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t programs = 5;
+    size_t loops = 8;
+    int iterations = 2000000;
+    uint64_t seed = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string arg = argv[i];
+        if (arg == "--programs")
+        {
+            programs = stoull(argv[i + 1]);
+        }
+        else if (arg == "--loops")
+        {
+            loops = stoull(argv[i + 1]);
+        }
+        else if (arg == "--iterations")
+        {
+            iterations = stoi(argv[i + 1]);
+        }
+        else if (arg == "--seed")
+        {
+            seed = stoull(argv[i + 1]);
+        }
+    }
+
+    const char *mode_names[] = {"plain", "fused", "blocks"};
+
+    cout << left << setw(10) << "Program" << setw(10) << "Mode"
+         << setw(16) << "Instructions" << setw(16) << "Dispatches"
+         << setw(12) << "Time (ms)" << setw(14) << "Instr/sec" << endl;
+    cout << string(78, '-') << endl;
+
+    const uint32_t patches = 16;
+    const uint64_t patched_steps = 1000000; // a patch can make a loop endless
+    uint64_t total_steps = 0, total_dispatches = 0;
+    double total_ms[3] = {};
+    for (size_t program = 0; program < programs; program++)
+    {
+        ProgramGenerator generator(seed + program);
+        string source = generator.generateLoops(loops, iterations);
+        ObjectModule module = assemble(source);
+        ProgramImage image = loadImage(module);
+
+        Simulator plain(image, false);
+        Simulator fused(image);
+        BlockCache blocks(image);
+        MachineState initial = plain.initialState();
+
+        ModeResult results[3] = {measure(plain, initial), measure(fused, initial), measure(blocks, initial)};
+        for (int mode = 0; mode < 3; mode++)
+        {
+            const ModeResult &run = results[mode];
+            bool same = run.result.status == results[0].result.status && run.result.steps == results[0].result.steps;
+            for (int i = 0; i < 5; i++)
+            {
+                same = same && run.state.registers[i] == results[0].state.registers[i];
+            }
+            if (!same)
+            {
+                cerr << "Error: " << mode_names[mode] << " run of program " << seed + program
+                     << " does not match the plain run!" << endl;
+                return 1;
+            }
+
+            uint64_t dispatches = run.result.steps - run.result.fused;
+            cout << left << setw(10) << seed + program << setw(10) << mode_names[mode]
+                 << setw(16) << run.result.steps << setw(16) << dispatches
+                 << setw(12) << fixed << setprecision(2) << run.ms
+                 << setw(14) << setprecision(0) << run.result.steps * 1000.0 / max(run.ms, 1e-3) << endl;
+            total_ms[mode] += run.ms;
+        }
+        total_steps += results[0].result.steps;
+        total_dispatches += results[1].result.steps - results[1].result.fused;
+
+        const Simulator &decoded = blocks.decoded();
+        uint32_t count = (uint32_t)decoded.instructionCount();
+        for (uint32_t patch = 0; patch < patches; patch++)
+        {
+            const ProgramImage &current = decoded.programImage();
+            int from = decoded.instruction((patch * 7 + 3) % count).lc;
+            int to = decoded.instruction((patch * 5 + (uint32_t)program) % count).lc;
+            blocks.patch(to, decodeInstruction(current.code[from - current.base]));
+
+            Simulator fresh(decoded.programImage());
+            MachineState cached_state = initial, fresh_state = initial;
+            SimResult cached = blocks.run(cached_state, patched_steps);
+            SimResult expected = fresh.run(fresh_state, patched_steps);
+            bool same = cached.status == expected.status && cached.steps == expected.steps &&
+                        cached.fused == expected.fused && cached_state.pc == fresh_state.pc;
+            for (int i = 0; i < 5; i++)
+            {
+                same = same && cached_state.registers[i] == fresh_state.registers[i];
+            }
+            if (!same)
+            {
+                cerr << "Error: blocks run of program " << seed + program << " after patching " << to
+                     << " does not match a fresh simulator!" << endl;
+                return 1;
+            }
+        }
+    }
+
+    cout << endl;
+    cout << "Dispatches removed by fusion: " << fixed << setprecision(1)
+         << 100.0 * (total_steps - total_dispatches) / max<uint64_t>(total_steps, 1) << "%" << endl;
+    cout << "Patched block runs matching: " << programs * patches << endl;
+    for (int mode = 0; mode < 3; mode++)
+    {
+        cout << left << setw(10) << mode_names[mode] << setprecision(0)
+             << total_steps * 1000.0 / max(total_ms[mode], 1e-3) << " instr/sec" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+// Reads the line starting at position out of text, without its "\n" or "\r\n",
+// and moves position past it. Returns false at the end of the text.
+inline bool nextLine(string_view text, size_t &position, string_view &line)
+{
+    if (position >= text.size())
+    {
+        return false;
+    }
+
+    size_t start = position;
+    size_t end = text.find('\n', start);
+    if (end == string_view::npos)
+    {
+        end = text.size();
+    }
+    position = end + 1;
+
+    if (end > start && text[end - 1] == '\r')
+    {
+        end--;
+    }
+    line = text.substr(start, end - start);
+    return true;
+}
+
+// Splits text into at most count pieces of similar size, each ending at a
+// line boundary, so the pieces can be worked on independently
+inline vector<string_view> splitChunks(string_view text, size_t count)
+{
+    vector<string_view> chunks;
+    size_t start = 0;
+    for (size_t i = 1; i <= count && start < text.size(); i++)
+    {
+        size_t end = text.size() * i / count;
+        if (end <= start)
+        {
+            continue;
+        }
+        end = text.find('\n', end - 1);
+        end = end == string_view::npos ? text.size() : end + 1;
+        chunks.push_back(text.substr(start, end - start));
+        start = end;
+    }
+    if (chunks.empty())
+    {
+        chunks.push_back(text);
+    }
+    return chunks;
+}
+
+// Gives the passes the whole source as one block of memory. Regular files are
+// memory-mapped; pipes and stdin ("-") are read into a buffer once. Lines and
+// tokens are handed out as string_views into that block, so nothing is copied
+// per line and the passes can walk the source as many times as they need.
+class SourceReader
+{
+private:
+    const char *data = nullptr;
+    size_t length = 0;
+    size_t position = 0;
+    bool mapped = false;
+    string buffer;
+
+    void useBuffer()
+    {
+        data = buffer.data();
+        length = buffer.size();
+    }
+
+#ifndef _WIN32
+    bool readDescriptor(int fd)
+    {
+        char chunk[1 << 16];
+        ssize_t count;
+        while ((count = read(fd, chunk, sizeof(chunk))) > 0)
+        {
+            buffer.append(chunk, count);
+        }
+        useBuffer();
+        return count == 0;
+    }
+#endif
+
+public:
+    SourceReader() {}
+    SourceReader(const SourceReader &) = delete;
+    SourceReader &operator=(const SourceReader &) = delete;
+
+    ~SourceReader()
+    {
+#ifndef _WIN32
+        if (mapped)
+        {
+            munmap((void *)data, length);
+        }
+#endif
+    }
+
+    bool open(const string &filename)
+    {
+#ifndef _WIN32
+        if (filename == "-")
+        {
+            return readDescriptor(STDIN_FILENO);
+        }
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+        {
+            void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+                data = (const char *)mapping;
+                length = info.st_size;
+                mapped = true;
+                close(fd);
+                return true;
+            }
+        }
+
+        // Not mappable (pipe, empty file, ...), fall back to reading it
+        bool ok = readDescriptor(fd);
+        close(fd);
+        return ok;
+#else
+        if (filename == "-")
+        {
+            buffer.assign(istreambuf_iterator<char>(cin), istreambuf_iterator<char>());
+            useBuffer();
+            return true;
+        }
+
+        ifstream inputFile(filename, ios::binary);
+        if (!inputFile)
+        {
+            return false;
+        }
+        buffer.assign(istreambuf_iterator<char>(inputFile), istreambuf_iterator<char>());
+        useBuffer();
+        return true;
+#endif
+    }
+
+    string_view text() const { return string_view(data, length); }
+
+    // Returns the next line without its "\n" or "\r\n", false at end of input
+    bool nextLine(string_view &line)
+    {
+        return ::nextLine(text(), position, line);
+    }
+
+    void rewind() { position = 0; }
+};
+
+// Splits a line at any of the delimiter characters into at most max_tokens
+// views, skipping empty tokens. Unused slots are left empty. Returns the
+// number of tokens found.
+inline int splitTokens(string_view line, string_view delimiters, string_view *tokens, int max_tokens)
+{
+    int count = 0;
+    size_t start = 0;
+
+    while (count < max_tokens)
+    {
+        start = line.find_first_not_of(delimiters, start);
+        if (start == string_view::npos)
+        {
+            break;
+        }
+        size_t end = line.find_first_of(delimiters, start);
+        if (end == string_view::npos)
+        {
+            end = line.size();
+        }
+        tokens[count++] = line.substr(start, end - start);
+        start = end;
+    }
+
+    for (int i = count; i < max_tokens; i++)
+    {
+        tokens[i] = string_view();
+    }
+    return count;
+}
+
+// stoi for views: leading digits with an optional sign, 0 if there are none
+inline int toInt(string_view text)
+{
+    int value = 0;
+    if (!text.empty() && text[0] == '+')
+    {
+        text.remove_prefix(1);
+    }
+    from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+// Assembler instrumentation: wall time and lines per phase, symbol and literal
+// lookups with the number of hash slots they probed (interned names, then
+// literal pools), allocations and bytes written. It exists only when built
+// with -DASSEMBLER_STATS; otherwise the STATS_* macros expand to nothing and
+// the hot paths are unchanged.
+//
+// The counters are process-wide relaxed atomics, so the parallel passes and
+// batch jobs add up into one set.
+//
+// Building with -DASSEMBLER_COUNT_ALLOCATIONS (implied by ASSEMBLER_STATS)
+// replaces the global operator new to count allocations. Every program here
+// is a single translation unit, which is what that replacement needs.
+
+#if defined(ASSEMBLER_STATS) && !defined(ASSEMBLER_COUNT_ALLOCATIONS)
+#define ASSEMBLER_COUNT_ALLOCATIONS
+#endif
+
+#ifdef ASSEMBLER_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+inline atomic<size_t> allocation_count{0};
+inline atomic<size_t> allocation_bytes{0};
+
+void *operator new(size_t size)
+{
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    allocation_bytes.fetch_add(size, memory_order_relaxed);
+    if (void *block = malloc(size == 0 ? 1 : size))
+    {
+        return block;
+    }
+    throw bad_alloc();
+}
+
+// Kept out of line so the compiler does not pair the inlined free() with a
+// standard operator new and warn about a mismatch
+[[gnu::noinline]] void operator delete(void *block) noexcept { free(block); }
+[[gnu::noinline]] void operator delete(void *block, size_t) noexcept { free(block); }
+#endif
+
+#ifdef ASSEMBLER_STATS
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+const bool STATS_ENABLED = true;
+
+enum class Phase
+{
+    SINGLE_PASS,
+    FIRST_PASS,
+    SECOND_PASS,
+    OPTIMIZE,
+    MACHINE_CODE,
+    OUTPUT,
+    COUNT
+};
+
+struct AssemblerStats
+{
+    struct PhaseStats
+    {
+        atomic<uint64_t> ns{0};
+        atomic<uint64_t> lines{0};
+    };
+
+    PhaseStats phases[(int)Phase::COUNT];
+    atomic<uint64_t> symbol_lookups{0};
+    atomic<uint64_t> name_probes{0}; // slots probed in StringPool, for symbols and literal values
+    atomic<uint64_t> literal_lookups{0};
+    atomic<uint64_t> literal_probes{0};
+    atomic<uint64_t> bytes_written{0};
+};
+
+inline AssemblerStats assembler_stats;
+
+// Adds the lifetime of the timer to a phase
+class PhaseTimer
+{
+private:
+    Phase phase;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+public:
+    explicit PhaseTimer(Phase phase) : phase(phase) {}
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+    ~PhaseTimer()
+    {
+        auto elapsed = chrono::steady_clock::now() - start;
+        assembler_stats.phases[(int)phase].ns.fetch_add(
+            chrono::duration_cast<chrono::nanoseconds>(elapsed).count(), memory_order_relaxed);
+    }
+};
+
+#define STATS_ADD(counter, n) assembler_stats.counter.fetch_add((n), memory_order_relaxed)
+#define STATS_LINE(phase) assembler_stats.phases[(int)Phase::phase].lines.fetch_add(1, memory_order_relaxed)
+#define STATS_PHASE(phase) PhaseTimer stats_phase_timer(Phase::phase)
+#else
+const bool STATS_ENABLED = false;
+
+#define STATS_ADD(counter, n) ((void)0)
+#define STATS_LINE(phase) ((void)0)
+#define STATS_PHASE(phase) ((void)0)
+#endif
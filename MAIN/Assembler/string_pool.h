@@ -0,0 +1,182 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include "stats.h"
+
+using namespace std;
+
+// Interned strings. Every distinct string is copied once into a bump arena
+// and gets a 32-bit id, 1-based in order of first appearance, so names can be
+// compared and hashed as integers once interned. Arena blocks never move:
+// views into the pool stay valid for its lifetime, also after it is moved.
+class StringPool
+{
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    vector<unique_ptr<char[]>> blocks;
+    char *cursor = nullptr;
+    size_t left = 0;
+    size_t arena_bytes = 0;
+
+    vector<string_view> strings; // text of id + 1
+    vector<uint32_t> hashes;     // hash of id + 1, for rehashing and quick rejects
+    vector<uint32_t> slots;      // 0 = empty, otherwise id
+    size_t mask = 0;
+
+    static uint32_t hashString(string_view text)
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (unsigned char c : text)
+        {
+            hash ^= c;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    // Copies text into the arena
+    string_view store(string_view text)
+    {
+        if (text.size() > left)
+        {
+            size_t size = max(BLOCK_SIZE, text.size());
+            blocks.push_back(make_unique<char[]>(size));
+            cursor = blocks.back().get();
+            left = size;
+            arena_bytes += size;
+        }
+        if (!text.empty())
+        {
+            memcpy(cursor, text.data(), text.size());
+        }
+        string_view stored(cursor, text.size());
+        cursor += text.size();
+        left -= text.size();
+        return stored;
+    }
+
+    void rehash(size_t capacity)
+    {
+        slots.assign(capacity, 0);
+        mask = capacity - 1;
+        for (size_t i = 0; i < hashes.size(); i++)
+        {
+            size_t slot = hashes[i] & mask;
+            while (slots[slot] != 0)
+            {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = i + 1;
+        }
+    }
+
+    uint32_t find(string_view text, uint32_t hash) const
+    {
+        size_t slot = hash & mask;
+        while (slots[slot] != 0)
+        {
+            STATS_ADD(name_probes, 1);
+            uint32_t id = slots[slot];
+            if (hashes[id - 1] == hash && strings[id - 1] == text)
+            {
+                return id;
+            }
+            slot = (slot + 1) & mask;
+        }
+        return 0;
+    }
+
+public:
+    StringPool()
+    {
+        rehash(16);
+    }
+
+    // Copies re-intern every string, so the copy's views point into its own arena
+    StringPool(const StringPool &other) : StringPool()
+    {
+        for (string_view text : other.strings)
+        {
+            intern(text);
+        }
+    }
+
+    StringPool &operator=(const StringPool &other)
+    {
+        if (this != &other)
+        {
+            StringPool copy(other);
+            *this = move(copy);
+        }
+        return *this;
+    }
+
+    StringPool(StringPool &&) = default;
+    StringPool &operator=(StringPool &&) = default;
+
+    // Returns the id of text, or 0 if it has not been interned
+    uint32_t find(string_view text) const
+    {
+        return find(text, hashString(text));
+    }
+
+    // Returns the id of text, adding it if it is new
+    uint32_t intern(string_view text)
+    {
+        uint32_t hash = hashString(text);
+        uint32_t id = find(text, hash);
+        if (id != 0)
+        {
+            return id;
+        }
+
+        strings.push_back(store(text));
+        hashes.push_back(hash);
+        id = strings.size();
+
+        // Keep the load factor at or below one half
+        if (strings.size() * 2 > slots.size())
+        {
+            rehash(slots.size() * 2);
+        }
+        else
+        {
+            size_t slot = hash & mask;
+            while (slots[slot] != 0)
+            {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = id;
+        }
+        return id;
+    }
+
+    // Text of an id returned by intern()
+    string_view operator[](uint32_t id) const { return strings[id - 1]; }
+
+    // Hash of an interned id, cheaper than hashing its text again
+    uint32_t hash(uint32_t id) const { return hashes[id - 1]; }
+
+    void clear()
+    {
+        blocks.clear();
+        cursor = nullptr;
+        left = 0;
+        arena_bytes = 0;
+        strings.clear();
+        hashes.clear();
+        rehash(16);
+    }
+
+    size_t size() const { return strings.size(); }
+    bool empty() const { return strings.empty(); }
+
+    // Bytes held by the arena blocks
+    size_t arenaBytes() const { return arena_bytes; }
+};
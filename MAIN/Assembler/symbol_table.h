@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "string_pool.h"
+#include "stats.h"
+
+using namespace std;
+
+// Symbol table that keeps entries in insertion order, so (S,n) in the
+// intermediate code still refers to entry n (1-based). Names are interned in
+// a StringPool whose ids are exactly those indices, so a lookup is one probe
+// sequence of the pool and an entry holds a view of its name, not a copy.
+class SymbolTable
+{
+private:
+    StringPool names;
+    vector<pair<string_view, int>> entries;
+
+public:
+    SymbolTable() = default;
+
+    SymbolTable(const SymbolTable &other) : names(other.names), entries(other.entries)
+    {
+        // Point the copied entries at this table's own arena
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            entries[i].first = names[i + 1];
+        }
+    }
+
+    SymbolTable &operator=(const SymbolTable &other)
+    {
+        if (this != &other)
+        {
+            SymbolTable copy(other);
+            *this = move(copy);
+        }
+        return *this;
+    }
+
+    SymbolTable(SymbolTable &&) = default;
+    SymbolTable &operator=(SymbolTable &&) = default;
+
+    // Returns the 1-based index of the symbol, or 0 if it is not in the table
+    int find(string_view name) const
+    {
+        STATS_ADD(symbol_lookups, 1);
+        return names.find(name);
+    }
+
+    // Appends a new symbol and returns its 1-based index. A name that is
+    // already in the table keeps its entry and index.
+    int add(string_view name, int address)
+    {
+        uint32_t id = names.intern(name);
+        if (id <= entries.size())
+        {
+            return id;
+        }
+        entries.push_back({names[id], address});
+        return id;
+    }
+
+    void clear()
+    {
+        names.clear();
+        entries.clear();
+    }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    // Bytes of the name arena
+    size_t nameBytes() const { return names.arenaBytes(); }
+
+    pair<string_view, int> &operator[](size_t i) { return entries[i]; }
+    const pair<string_view, int> &operator[](size_t i) const { return entries[i]; }
+
+    vector<pair<string_view, int>>::iterator begin() { return entries.begin(); }
+    vector<pair<string_view, int>>::iterator end() { return entries.end(); }
+    vector<pair<string_view, int>>::const_iterator begin() const { return entries.begin(); }
+    vector<pair<string_view, int>>::const_iterator end() const { return entries.end(); }
+};
@@ -0,0 +1,153 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <chrono>
+#include "symbol_table.h"
+
+using namespace std;
+
+// Symbol table scaling benchmark.
+// Replays the symbol traffic of a source with n labels: pass 1 defines every
+// label, pass 2 looks each one up twice as an instruction operand.
+
+vector<string> makeNames(int n)
+{
+    vector<string> names;
+    names.reserve(n);
+    for (int i = 0; i < n; i++)
+    {
+        names.push_back("LABEL" + to_string(i));
+    }
+    return names;
+}
+
+double runHashed(const vector<string> &names)
+{
+    auto begin = chrono::steady_clock::now();
+
+    SymbolTable symbol_table;
+    int lc = 100;
+    long checksum = 0;
+
+    // Pass 1: define every label
+    for (const auto &name : names)
+    {
+        int symbol_index = symbol_table.find(name);
+        if (symbol_index == 0)
+        {
+            symbol_table.add(name, lc);
+        }
+        lc += 2;
+    }
+
+    // Pass 2: every label is referenced twice as an operand
+    for (int round = 0; round < 2; round++)
+    {
+        for (const auto &name : names)
+        {
+            int symbol_index = symbol_table.find(name);
+            if (symbol_index == 0)
+            {
+                symbol_index = symbol_table.add(name, -1);
+            }
+            checksum += symbol_table[symbol_index - 1].second;
+        }
+    }
+
+    auto finish = chrono::steady_clock::now();
+    if (checksum == 0)
+    {
+        cerr << "unexpected checksum" << endl;
+    }
+    return chrono::duration<double, milli>(finish - begin).count();
+}
+
+double runLinear(const vector<string> &names)
+{
+    auto begin = chrono::steady_clock::now();
+
+    vector<pair<string, int>> symbol_table;
+    int lc = 100;
+    long checksum = 0;
+
+    for (const auto &name : names)
+    {
+        bool found = false;
+        for (auto &sym : symbol_table)
+        {
+            if (sym.first == name)
+            {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+        {
+            symbol_table.push_back({name, lc});
+        }
+        lc += 2;
+    }
+
+    for (int round = 0; round < 2; round++)
+    {
+        for (const auto &name : names)
+        {
+            int symbol_index = 0;
+            for (size_t i = 0; i < symbol_table.size(); ++i)
+            {
+                if (symbol_table[i].first == name)
+                {
+                    symbol_index = i + 1;
+                    break;
+                }
+            }
+            if (symbol_index == 0)
+            {
+                symbol_table.push_back({name, -1});
+                symbol_index = symbol_table.size();
+            }
+            checksum += symbol_table[symbol_index - 1].second;
+        }
+    }
+
+    auto finish = chrono::steady_clock::now();
+    if (checksum == 0)
+    {
+        cerr << "unexpected checksum" << endl;
+    }
+    return chrono::duration<double, milli>(finish - begin).count();
+}
+
+int main()
+{
+    const int sizes[] = {1000, 4000, 16000, 64000, 256000, 1024000};
+    const int linear_limit = 16000; // the linear scan is quadratic, stop it early
+
+    cout << left << setw(12) << "Symbols"
+         << setw(16) << "Hashed (ms)"
+         << setw(16) << "ns/symbol"
+         << setw(16) << "Linear (ms)" << endl;
+    cout << string(60, '-') << endl;
+
+    for (int n : sizes)
+    {
+        vector<string> names = makeNames(n);
+        double hashed = runHashed(names);
+
+        cout << left << setw(12) << n
+             << setw(16) << fixed << setprecision(2) << hashed
+             << setw(16) << hashed * 1e6 / n;
+        if (n <= linear_limit)
+        {
+            cout << setw(16) << runLinear(names);
+        }
+        else
+        {
+            cout << setw(16) << "-";
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
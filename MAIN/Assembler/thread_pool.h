@@ -0,0 +1,164 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+
+using namespace std;
+
+// Work-stealing thread pool. Every worker has its own task deque: it takes
+// work from the back of its own deque and, when that is empty, steals from
+// the front of the other workers' deques, so uneven tasks (one huge source
+// among many small ones) still keep every core busy.
+class ThreadPool
+{
+private:
+    struct WorkQueue
+    {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    vector<unique_ptr<WorkQueue>> queues;
+    vector<thread> workers;
+
+    mutex wake_lock;
+    condition_variable wake;
+    atomic<size_t> queued{0}; // tasks sitting in a deque, changed under its lock
+    bool stopping = false;
+
+    mutex done_lock;
+    condition_variable done;
+    size_t pending = 0; // tasks submitted and not finished yet
+
+    atomic<size_t> next_queue{0};
+
+    bool popLocal(size_t index, function<void()> &task)
+    {
+        WorkQueue &queue = *queues[index];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.tasks.empty())
+        {
+            return false;
+        }
+        task = move(queue.tasks.back());
+        queue.tasks.pop_back();
+        queued--;
+        return true;
+    }
+
+    bool steal(size_t index, function<void()> &task)
+    {
+        for (size_t i = 1; i < queues.size(); i++)
+        {
+            WorkQueue &queue = *queues[(index + i) % queues.size()];
+            lock_guard<mutex> guard(queue.lock);
+            if (!queue.tasks.empty())
+            {
+                task = move(queue.tasks.front());
+                queue.tasks.pop_front();
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(size_t index)
+    {
+        function<void()> task;
+        while (true)
+        {
+            if (popLocal(index, task) || steal(index, task))
+            {
+                task();
+                task = nullptr;
+
+                lock_guard<mutex> guard(done_lock);
+                if (--pending == 0)
+                {
+                    done.notify_all();
+                }
+                continue;
+            }
+
+            unique_lock<mutex> guard(wake_lock);
+            wake.wait(guard, [&]
+                      { return stopping || queued.load() > 0; });
+            if (stopping && queued.load() == 0)
+            {
+                return;
+            }
+        }
+    }
+
+public:
+    explicit ThreadPool(size_t count = thread::hardware_concurrency())
+    {
+        if (count == 0)
+        {
+            count = 1;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            queues.push_back(make_unique<WorkQueue>());
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            workers.emplace_back(&ThreadPool::run, this, i);
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            lock_guard<mutex> guard(wake_lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    size_t size() const { return workers.size(); }
+
+    void submit(function<void()> task)
+    {
+        {
+            lock_guard<mutex> guard(done_lock);
+            pending++;
+        }
+
+        WorkQueue &queue = *queues[next_queue++ % queues.size()];
+        {
+            lock_guard<mutex> guard(queue.lock);
+            queue.tasks.push_back(move(task));
+            queued++;
+        }
+
+        // A worker checks queued under wake_lock before it sleeps, so taking
+        // the lock here means it either sees the task or gets the notify
+        {
+            lock_guard<mutex> guard(wake_lock);
+        }
+        wake.notify_one();
+    }
+
+    // Blocks until every submitted task has finished
+    void wait()
+    {
+        unique_lock<mutex> guard(done_lock);
+        done.wait(guard, [&]
+                  { return pending == 0; });
+    }
+};